@@ -118,6 +118,10 @@ void ScriptEditorWindow::createUi()
     auto *sendButton = new QPushButton(tr("Send Script"), bottom);
     bottomLayout->addWidget(sendButton);
 
+    auto *sendImageButton = new QPushButton(tr("Send Image..."), bottom);
+    sendImageButton->setToolTip(tr("Sends an image the runner's scripts can draw with canvas.image(x, y, key)."));
+    bottomLayout->addWidget(sendImageButton);
+
     vLayout->addWidget(bottom);
 
     setCentralWidget(central);
@@ -148,6 +152,7 @@ void ScriptEditorWindow::createUi()
             this, &ScriptEditorWindow::bindUdpPort);
 
     connect(sendButton, &QPushButton::clicked, this, &ScriptEditorWindow::sendScriptToRunner);
+    connect(sendImageButton, &QPushButton::clicked, this, &ScriptEditorWindow::sendImageToRunner);
     connect(m_profileCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
             this, &ScriptEditorWindow::onProfileChanged);
 
@@ -257,24 +262,68 @@ void ScriptEditorWindow::bindUdpPort()
     qCInfo(lcEditorUi) << "Binding editor transport on port" << port;
 }
 
-void ScriptEditorWindow::sendScriptToRunner()
+bool ScriptEditorWindow::targetEndpoint(TransportEndpoint *endpoint)
 {
     const QHostAddress targetAddress(m_targetAddressEdit->text());
-    const quint16 targetPort = static_cast<quint16>(m_targetPortSpin->value());
-    const QByteArray scriptData = m_document->text().toUtf8();
-
     if (targetAddress.isNull()) {
         QMessageBox::warning(this, tr("Error"), tr("Invalid target IP address."));
         qCWarning(lcEditorUi) << "Invalid runner IP address" << m_targetAddressEdit->text();
-        return;
+        return false;
     }
 
+    endpoint->address = targetAddress;
+    endpoint->port = static_cast<quint16>(m_targetPortSpin->value());
+    return true;
+}
+
+void ScriptEditorWindow::sendScriptToRunner()
+{
+    const QByteArray scriptData = m_document->text().toUtf8();
+    TransportEndpoint endpoint;
+    if (!targetEndpoint(&endpoint))
+        return;
+
     // Transport layer handles retries/logging; we only need to provide bytes.
-    TransportEndpoint endpoint { targetAddress, targetPort };
-    qCInfo(lcEditorUi) << "Sending script payload to" << targetAddress << targetPort;
+    qCInfo(lcEditorUi) << "Sending script payload to" << endpoint.address << endpoint.port;
     m_transport->sendScript(scriptData, endpoint);
 }
 
+void ScriptEditorWindow::sendImageToRunner()
+{
+    TransportEndpoint endpoint;
+    if (!targetEndpoint(&endpoint))
+        return;
+
+    const QString fileName = QFileDialog::getOpenFileName(this,
+        tr("Send image to runner"), QString(),
+        tr("Images (*.png *.jpg *.jpeg *.bmp *.gif);;All Files (*.*)"));
+    if (fileName.isEmpty())
+        return;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QMessageBox::warning(this, tr("Error"),
+                             tr("Failed to open file:\n%1").arg(fileName));
+        return;
+    }
+    const QByteArray encoded = file.readAll();
+
+    // The whole image travels in one datagram.
+    const int maxPayload = 65000;
+    if (encoded.size() > maxPayload) {
+        QMessageBox::warning(this, tr("Error"),
+                             tr("%1 is %2 bytes; images sent over UDP must stay under %3 bytes.\n"
+                                "Put larger images in the runner's images directory instead.")
+                                 .arg(QFileInfo(fileName).fileName()).arg(encoded.size()).arg(maxPayload));
+        return;
+    }
+
+    // Scripts refer to the image by its file name.
+    const QString key = QFileInfo(fileName).fileName();
+    qCInfo(lcEditorUi) << "Sending image" << key << "to" << endpoint.address << endpoint.port;
+    m_transport->sendImage(key, encoded, endpoint);
+}
+
 void ScriptEditorWindow::handleScriptRequest(const TransportEndpoint &sender)
 {
     qCInfo(lcEditorUi) << "Script requested by" << sender.address << sender.port;
@@ -36,6 +36,7 @@ private slots:
 
     void bindUdpPort();
     void sendScriptToRunner();
+    void sendImageToRunner();
     void handleScriptRequest(const TransportEndpoint &sender);
     void handleServerStatusMessage(const QString &message);
     void onProfileChanged(int index);
@@ -47,6 +48,7 @@ private:
     void updateWindowTitle();
     void loadProfiles();
     void applyProfile(const NetworkProfile &profile);
+    bool targetEndpoint(TransportEndpoint *endpoint);
 
     static QString exampleScriptText();
 
@@ -1,18 +1,42 @@
 #include "CanvasWidget.h"
 
+#include "CanvasRenderer.h"
 #include "CanvasState.h"
+#include "FrameScheduler.h"
 
+#include <QElapsedTimer>
 #include <QPainter>
 #include <QPaintEvent>
+#include <QResizeEvent>
 #include <QtGlobal>
 
+#include <cstring>
+
+namespace {
+
+// Per-frame rendering budget; leaves room for input handling at 60 Hz.
+const qint64 kSliceBudgetMs = 10;
+const int kMinSliceChunk = 256;
+const int kMaxSliceChunk = 65536;
+
+} // namespace
+
 CanvasWidget::CanvasWidget(QWidget *parent)
     : QWidget(parent)
     , m_state(nullptr)
+    , m_frameScheduler(new FrameScheduler(this))
     , m_background(Qt::white)
     , m_zoom(1.0)
+    , m_sliceChunk(kMinSliceChunk)
+    , m_fullRepaint(false)
 {
     setMinimumSize(400, 300);
+    // The background fill covers every pixel, so Qt does not need to erase first.
+    setAttribute(Qt::WA_OpaquePaintEvent);
+
+    // Model signals only mark the view dirty; the scheduler decides when to paint.
+    connect(m_frameScheduler, &FrameScheduler::frameRequested,
+            this, &CanvasWidget::onFrameRequested);
 }
 
 void CanvasWidget::setCanvasState(CanvasState *state)
@@ -22,16 +46,22 @@ void CanvasWidget::setCanvasState(CanvasState *state)
 
     disconnectState();
     m_state = state;
+    invalidateCache();
 
     if (m_state) {
         // React to all state change signals so repaint logic stays local.
         connect(m_state, &CanvasState::shapesChanged,
                 this, &CanvasWidget::onShapesChanged);
+        connect(m_state, &CanvasState::shapesSpliced,
+                this, &CanvasWidget::onShapesSpliced);
+        connect(m_state, &CanvasState::layerRemoved,
+                this, &CanvasWidget::onLayerRemoved);
         connect(m_state, &CanvasState::backgroundChanged,
                 this, &CanvasWidget::onBackgroundChanged);
         connect(m_state, &CanvasState::zoomChanged,
                 this, &CanvasWidget::onZoomChanged);
 
+        m_shapes.clear();
         onShapesChanged(m_state->shapes());
         onBackgroundChanged(m_state->backgroundColor());
         onZoomChanged(m_state->zoomFactor());
@@ -39,14 +69,16 @@ void CanvasWidget::setCanvasState(CanvasState *state)
         m_shapes.clear();
         m_background = Qt::white;
         m_zoom = 1.0;
-        update();
+        scheduleRepaint();
     }
 }
 
 void CanvasWidget::setShapes(const ShapeList &shapes)
 {
     m_shapes = shapes;
-    update();
+    if (!m_state)
+        invalidateCache();
+    scheduleRepaint();
 }
 
 QSize CanvasWidget::sizeHint() const
@@ -56,101 +88,290 @@ QSize CanvasWidget::sizeHint() const
 
 void CanvasWidget::paintEvent(QPaintEvent *event)
 {
-    Q_UNUSED(event);
+    updateCache();
 
+    // Static and append-only scenes reduce to one blit per non-empty layer,
+    // clipped by Qt to the exposed region.
+    Q_UNUSED(event);
     QPainter p(this);
-    p.setRenderHint(QPainter::Antialiasing, true);
-
     p.fillRect(rect(), m_background);
-    p.save();
-    if (!qFuzzyCompare(m_zoom, 1.0))
-        p.scale(m_zoom, m_zoom);
-
-    for (const Shape &s : m_shapes) {
-        // Rendering intentionally mirrors ScriptCanvas packing rules.
-        switch (s.type) {
-        case ShapeType::FilledCircle: {
-            const QPointF c = s.p1;
-            const qreal r = s.p2.x();
-            p.setPen(Qt::NoPen);
-            p.setBrush(s.fillColor);
-            p.drawEllipse(c, r, r);
-            break;
-        }
-        case ShapeType::StrokeCircle: {
-            const QPointF c = s.p1;
-            const qreal r = s.p2.x();
-            QPen pen(s.strokeColor, s.penWidth);
-            p.setPen(pen);
-            p.setBrush(Qt::NoBrush);
-            p.drawEllipse(c, r, r);
-            break;
-        }
-        case ShapeType::Rect: {
-            const QRectF rect(s.p1, QSizeF(s.p2.x(), s.p2.y()));
-            QPen pen;
-            if (s.strokeColor.isValid()) {
-                pen = QPen(s.strokeColor, s.penWidth);
-            } else {
-                pen = Qt::NoPen;
-            }
-            p.setPen(pen);
+    for (const LayerCache &layer : m_layers) {
+        if (!layer.image.isNull())
+            p.drawImage(QPoint(0, 0), layer.image);
+    }
+}
 
-            if (s.fillColor.isValid())
-                p.setBrush(s.fillColor);
-            else
-                p.setBrush(Qt::NoBrush);
+void CanvasWidget::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    invalidateCache();
+}
 
-            p.drawRect(rect);
-            break;
-        }
-        case ShapeType::Triangle: {
-            QPolygonF poly;
-            poly << s.p1 << s.p2 << s.p3;
-
-            QPen pen;
-            if (s.strokeColor.isValid())
-                pen = QPen(s.strokeColor, s.penWidth);
-            else
-                pen = Qt::NoPen;
-
-            p.setPen(pen);
-            if (s.fillColor.isValid())
-                p.setBrush(s.fillColor);
-            else
-                p.setBrush(Qt::NoBrush);
-
-            p.drawPolygon(poly);
-            break;
-        }
-        case ShapeType::Line: {
-            QPen pen(s.strokeColor, s.penWidth);
-            p.setPen(pen);
-            p.setBrush(Qt::NoBrush);
-            p.drawLine(s.p1, s.p2);
-            break;
-        }
-        }
-    }
-    p.restore();
+void CanvasWidget::onFrameRequested()
+{
+    if (m_fullRepaint)
+        update();
+    else if (!m_dirtyRect.isEmpty())
+        update(m_dirtyRect);
+    m_fullRepaint = false;
+    m_dirtyRect = QRect();
 }
 
 void CanvasWidget::onShapesChanged(const ShapeList &shapes)
 {
-    m_shapes = shapes;
-    update();
+    // Painting reads straight from CanvasState; holding a copy here would
+    // force the model to detach its buffer on every append.
+    Q_UNUSED(shapes);
+    if (!m_state) {
+        scheduleRepaint();
+        return;
+    }
+
+    // Splices already scheduled their damage; anything else (appends,
+    // removals, new layers) still needs the whole view.
+    bool inSync = m_layers.size() == m_state->layerCount();
+    for (int i = 0; inSync && i < m_layers.size(); ++i) {
+        const LayerCache &layer = m_layers.at(i);
+        const int size = m_state->shapes(i).size();
+        inSync = size == 0 ? layer.image.isNull()
+                           : layer.valid && layer.queuedCount == size
+                                 && layer.generation == m_state->shapesGeneration(i);
+    }
+    if (!inSync)
+        scheduleRepaint();
+}
+
+void CanvasWidget::onShapesSpliced(int layer, int first, int removed, int inserted, const QRectF &damage)
+{
+    Q_UNUSED(first);
+    if (layer >= m_layers.size())
+        return;
+
+    // Repairing in place needs a finished cache that matches the shapes as
+    // they were before the splice; otherwise the layer renders from scratch.
+    LayerCache &cache = m_layers[layer];
+    const int before = m_state->shapes(layer).size() - inserted + removed;
+    if (!cache.valid || cache.pendingPos < cache.pending.size() || cache.queuedCount != before) {
+        cache.valid = false;
+        scheduleRepaint();
+        return;
+    }
+    cache.queuedCount += inserted - removed;
+
+    // One device pixel of slack covers antialiasing outside the bounds.
+    const qreal dpr = cache.image.devicePixelRatio();
+    const qreal scale = m_zoom * dpr;
+    const QRect pixels = QRectF(damage.x() * scale, damage.y() * scale,
+                                damage.width() * scale, damage.height() * scale)
+                             .toAlignedRect().adjusted(-1, -1, 1, 1);
+    cache.damage = cache.damage.isNull() ? pixels : cache.damage.united(pixels);
+    scheduleRepaint(QRectF(pixels.x() / dpr, pixels.y() / dpr,
+                           pixels.width() / dpr, pixels.height() / dpr).toAlignedRect());
+}
+
+void CanvasWidget::onLayerRemoved(int layer)
+{
+    // The layers above keep their pixels; they only move down with their
+    // generations, so the next update finds them still valid.
+    if (layer < m_layers.size())
+        m_layers.remove(layer);
+    scheduleRepaint();
 }
 
 void CanvasWidget::onBackgroundChanged(const QColor &color)
 {
+    // Layers are transparent, so only the composite changes.
     m_background = color;
-    update();
+    scheduleRepaint();
 }
 
 void CanvasWidget::onZoomChanged(qreal zoom)
 {
     m_zoom = zoom;
-    update();
+    invalidateCache();
+    scheduleRepaint();
+}
+
+int CanvasWidget::shapeAt(const QPoint &pos, int *layer) const
+{
+    if (!m_state)
+        return -1;
+
+    const qreal zoom = m_zoom > 0.0 ? m_zoom : 1.0;
+    const QPointF scenePos((pos.x() + 0.5) / zoom, (pos.y() + 0.5) / zoom);
+    // Give thin strokes a couple of screen pixels of slack.
+    return m_state->shapeAt(scenePos, 2.0 / zoom, layer);
+}
+
+void CanvasWidget::setLevelOfDetail(const LevelOfDetail &lod)
+{
+    m_tileRenderer.setLevelOfDetail(lod);
+    invalidateCache();
+    scheduleRepaint();
+}
+
+LevelOfDetail CanvasWidget::levelOfDetail() const
+{
+    return m_tileRenderer.levelOfDetail();
+}
+
+QRectF CanvasWidget::sceneRect(const QRect &widgetRect) const
+{
+    // Shared with offscreen rendering so both cull exactly the same shapes.
+    return CanvasRenderer::sceneRect(QRectF(widgetRect), m_zoom);
+}
+
+void CanvasWidget::scheduleRepaint()
+{
+    m_fullRepaint = true;
+    m_frameScheduler->requestFrame();
+}
+
+void CanvasWidget::scheduleRepaint(const QRect &widgetRect)
+{
+    m_dirtyRect = m_dirtyRect.united(widgetRect);
+    m_frameScheduler->requestFrame();
+}
+
+void CanvasWidget::invalidateCache()
+{
+    for (LayerCache &layer : m_layers)
+        layer.valid = false;
+}
+
+void CanvasWidget::updateCache()
+{
+    const qreal dpr = devicePixelRatioF();
+    const QSize pixelSize = size() * dpr;
+
+    // Layers are only ever added on top, removed one at a time (see
+    // onLayerRemoved()), or dropped all at once by a reset, which also bumps
+    // the generations of the survivors.
+    m_layers.resize(layerCount());
+    for (int i = 0; i < m_layers.size(); ++i)
+        updateLayer(i, pixelSize, dpr);
+
+    renderSlice();
+}
+
+void CanvasWidget::updateLayer(int index, const QSize &pixelSize, qreal dpr)
+{
+    LayerCache &layer = m_layers[index];
+    const ShapeList &shapes = layerShapes(index);
+    if (shapes.isEmpty()) {
+        // Nothing to retain; dropping the image also skips it when compositing.
+        layer = LayerCache();
+        return;
+    }
+
+    const quint64 generation = m_state ? m_state->shapesGeneration(index) : 0;
+    if (layer.image.size() != pixelSize || !qFuzzyCompare(layer.image.devicePixelRatio(), dpr))
+        layer.valid = false;
+    if (generation != layer.generation)
+        layer.valid = false;
+    if (shapes.size() < layer.queuedCount)
+        layer.valid = false;
+
+    if (!layer.valid) {
+        // Restart from scratch; whatever an interrupted pass queued is stale.
+        if (layer.image.size() != pixelSize)
+            layer.image = QImage(pixelSize, QImage::Format_ARGB32_Premultiplied);
+        layer.image.setDevicePixelRatio(dpr);
+        layer.image.fill(Qt::transparent);
+        layer.pending.clear();
+        layer.pendingPos = 0;
+        layer.queuedCount = 0;
+        layer.generation = generation;
+        layer.damage = QRect();
+        layer.valid = true;
+    }
+
+    if (!layer.damage.isNull())
+        repairLayer(index);
+
+    if (layer.queuedCount < shapes.size()) {
+        const QRectF visible = sceneRect(rect());
+        if (layer.queuedCount == 0 && m_state) {
+            // Full re-render: let the spatial index cull what is off screen.
+            layer.pending = m_state->shapesIn(index, visible);
+            layer.pendingPos = 0;
+        } else {
+            for (int i = layer.queuedCount; i < shapes.size(); ++i) {
+                if (boundsTouch(shapes.at(i).boundingRect(), visible))
+                    layer.pending.append(i);
+            }
+        }
+        layer.queuedCount = shapes.size();
+    }
+}
+
+void CanvasWidget::repairLayer(int index)
+{
+    LayerCache &layer = m_layers[index];
+    const QRect area = layer.damage.intersected(layer.image.rect());
+    layer.damage = QRect();
+    if (area.isEmpty())
+        return;
+
+    // Transparent premultiplied pixels are all zero bits.
+    const int bytesPerPixel = layer.image.depth() / 8;
+    for (int y = area.top(); y <= area.bottom(); ++y)
+        std::memset(layer.image.scanLine(y) + area.left() * bytesPerPixel, 0, size_t(area.width()) * bytesPerPixel);
+
+    // Redraw everything reaching into the area, changed or not, widened by
+    // the same pixel of antialiasing slack.
+    const qreal scale = m_zoom * layer.image.devicePixelRatio();
+    const QRectF scene((area.x() - 1) / scale, (area.y() - 1) / scale,
+                       (area.width() + 2) / scale, (area.height() + 2) / scale);
+    m_tileRenderer.renderRect(layer.image, area, layerShapes(index), m_state->shapesIn(index, scene), m_zoom);
+}
+
+void CanvasWidget::renderSlice()
+{
+    // Draw in chunks, bottom layer first, until the frame budget is spent.
+    // The chunk size follows the measured throughput so one chunk never
+    // blows the budget by much.
+    const qint64 budgetNs = kSliceBudgetMs * 1000000;
+    QElapsedTimer slice;
+    slice.start();
+    for (int l = 0; l < m_layers.size(); ++l) {
+        LayerCache &layer = m_layers[l];
+        const ShapeList &shapes = layerShapes(l);
+        while (layer.pendingPos < layer.pending.size() && slice.nsecsElapsed() < budgetNs) {
+            const int count = qMin(m_sliceChunk, layer.pending.size() - layer.pendingPos);
+            QElapsedTimer chunk;
+            chunk.start();
+            // Large chunks fan out over the thread pool, small ones stay serial.
+            m_tileRenderer.render(layer.image, shapes, layer.pending.mid(layer.pendingPos, count), m_zoom);
+            layer.pendingPos += count;
+
+            const qint64 chunkNs = qMax<qint64>(1, chunk.nsecsElapsed());
+            const qint64 remainingNs = budgetNs - slice.nsecsElapsed();
+            if (remainingNs <= 0)
+                break;
+            const qint64 affordable = qint64(count) * remainingNs / chunkNs;
+            m_sliceChunk = int(qBound<qint64>(kMinSliceChunk, affordable, kMaxSliceChunk));
+        }
+
+        if (layer.pendingPos < layer.pending.size()) {
+            // Show the partial result now and continue after the event loop
+            // has had a chance to deliver input and network traffic.
+            scheduleRepaint();
+            return;
+        }
+        layer.pending.clear();
+        layer.pendingPos = 0;
+    }
+}
+
+int CanvasWidget::layerCount() const
+{
+    return m_state ? m_state->layerCount() : 1;
+}
+
+const ShapeList &CanvasWidget::layerShapes(int index) const
+{
+    return m_state ? m_state->shapes(index) : m_shapes;
 }
 
 void CanvasWidget::disconnectState()
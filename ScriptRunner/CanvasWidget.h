@@ -3,11 +3,22 @@
 
 #include <QWidget>
 #include <QColor>
+#include <QImage>
 #include "Shapes.h"
+#include "TileRenderer.h"
 
 class CanvasState;
+class FrameScheduler;
 
-// Passive view that repaints whenever CanvasState changes.
+// Passive view that repaints whenever CanvasState changes. Each layer is
+// retained in its own transparent backing image and the images are
+// composited over the background. Appended shapes are drawn onto their
+// layer's image; removals re-render only that layer, while zoom or size
+// changes re-render all of them. Spliced runs (a re-executed script that
+// changed a few shapes) are repaired in place: only the damaged pixels are
+// cleared, redrawn and pushed to the screen. Rendering into the images is time-sliced,
+// so scenes too big for one frame fill in progressively while the event
+// loop keeps running.
 class CanvasWidget : public QWidget
 {
     Q_OBJECT
@@ -15,24 +26,75 @@ public:
     explicit CanvasWidget(QWidget *parent = nullptr);
 
     void setCanvasState(CanvasState *state);
+    // Standalone mode: painted only while no CanvasState is attached.
     void setShapes(const ShapeList &shapes);
 
+    // Index of the topmost shape under a widget position, or -1. The shape's
+    // layer is stored in layer when given.
+    int shapeAt(const QPoint &pos, int *layer = nullptr) const;
+
+    // Controls culling/point substitution of sub-pixel shapes when zoomed out.
+    void setLevelOfDetail(const LevelOfDetail &lod);
+    LevelOfDetail levelOfDetail() const;
+
 protected:
     void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
     QSize sizeHint() const override;
 
 private slots:
+    void onFrameRequested();
     void onShapesChanged(const ShapeList &shapes);
+    void onShapesSpliced(int layer, int first, int removed, int inserted, const QRectF &damage);
+    void onLayerRemoved(int layer);
     void onBackgroundChanged(const QColor &color);
     void onZoomChanged(qreal zoom);
 
 private:
+    // Retained pixels of one layer plus the shapes still queued for them.
+    struct LayerCache
+    {
+        LayerCache()
+            : valid(false)
+            , generation(0)
+            , queuedCount(0)
+            , pendingPos(0)
+        {}
+
+        QImage       image;
+        bool         valid;
+        quint64      generation;
+        int          queuedCount;
+        QVector<int> pending;
+        int          pendingPos;
+        // Device pixels to clear and redraw after shapes were spliced.
+        QRect        damage;
+    };
+
     void disconnectState();
+    QRectF sceneRect(const QRect &widgetRect) const;
+    void scheduleRepaint();
+    void scheduleRepaint(const QRect &widgetRect);
+    void invalidateCache();
+    void updateCache();
+    void updateLayer(int index, const QSize &pixelSize, qreal dpr);
+    void repairLayer(int index);
+    void renderSlice();
+    int layerCount() const;
+    const ShapeList &layerShapes(int index) const;
+
+    CanvasState    *m_state;
+    FrameScheduler *m_frameScheduler;
+    ShapeList       m_shapes;
+    QColor          m_background;
+    qreal           m_zoom;
 
-    CanvasState *m_state;
-    ShapeList    m_shapes;
-    QColor       m_background;
-    qreal        m_zoom;
+    TileRenderer        m_tileRenderer;
+    QVector<LayerCache> m_layers;
+    int                 m_sliceChunk;
+    // Area the next frame repaints, unless the whole widget is due.
+    QRect               m_dirtyRect;
+    bool                m_fullRepaint;
 };
 
 #endif 
@@ -0,0 +1,47 @@
+#include "FrameScheduler.h"
+
+#include <QGuiApplication>
+#include <QScreen>
+#include <QTimer>
+#include <QtGlobal>
+
+FrameScheduler::FrameScheduler(QObject *parent)
+    : QObject(parent)
+    , m_timer(new QTimer(this))
+    , m_intervalMs(16)
+{
+    m_timer->setSingleShot(true);
+    m_timer->setTimerType(Qt::PreciseTimer);
+    connect(m_timer, &QTimer::timeout,
+            this, &FrameScheduler::onTimeout);
+
+    if (QScreen *screen = QGuiApplication::primaryScreen())
+        setRefreshRate(screen->refreshRate());
+}
+
+void FrameScheduler::setRefreshRate(qreal hz)
+{
+    // Some platforms report 0 for virtual screens; keep the 60 Hz default then.
+    if (hz <= 0.0)
+        return;
+
+    m_intervalMs = qMax(1, qRound(1000.0 / hz));
+}
+
+void FrameScheduler::requestFrame()
+{
+    if (m_timer->isActive())
+        return;
+
+    // An idle view repaints right away; a busy one waits for the next slot.
+    int delay = 0;
+    if (m_sinceLastFrame.isValid())
+        delay = static_cast<int>(qMax<qint64>(0, m_intervalMs - m_sinceLastFrame.elapsed()));
+    m_timer->start(delay);
+}
+
+void FrameScheduler::onTimeout()
+{
+    m_sinceLastFrame.restart();
+    emit frameRequested();
+}
@@ -0,0 +1,32 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+
+class QTimer;
+
+// Coalesces repaint requests so a burst of model changes produces at most
+// one frame per display refresh instead of one update() per change.
+class FrameScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FrameScheduler(QObject *parent = nullptr);
+
+    void setRefreshRate(qreal hz);
+    void requestFrame();
+
+signals:
+    void frameRequested();
+
+private slots:
+    void onTimeout();
+
+private:
+    QTimer       *m_timer;
+    QElapsedTimer m_sinceLastFrame;
+    int           m_intervalMs;
+};
+
+#endif
@@ -0,0 +1,763 @@
+#include "HeadlessRunner.h"
+
+#include "CanvasRenderer.h"
+#include "CanvasState.h"
+#include "FillRasterizer.h"
+#include "IScriptEngine.h"
+#include "ScriptBindings.h"
+#include "SceneRenderer.h"
+#include "ScriptCanvas.h"
+
+#include <QCommandLineParser>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QPair>
+#include <QScopedPointer>
+#include <QSet>
+#include <QTextStream>
+#include <QThread>
+
+#include <deque>
+#include <limits>
+#include <vector>
+
+Q_LOGGING_CATEGORY(lcHeadless, "script.headless")
+
+namespace {
+
+const QSize kDefaultSize(480, 360);
+// Workers never idle, so each collects its engine's garbage every this many
+// scripts, before the next one starts its clock.
+const int kGcInterval = 16;
+
+QTextStream &out()
+{
+    static QTextStream stream(stdout);
+    return stream;
+}
+
+QTextStream &err()
+{
+    static QTextStream stream(stderr);
+    return stream;
+}
+
+double toMs(qint64 ns)
+{
+    return ns / 1000000.0;
+}
+
+// Opaque backdrop whose channels all vary, so fills are blended against many
+// destination values.
+QImage fillBackdrop()
+{
+    QImage image(96, 96, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x)
+            line[x] = qRgb((x * 7) & 0xff, (y * 5) & 0xff, ((x + y) * 3) & 0xff);
+    }
+    return image;
+}
+
+// Largest difference of any channel between two images of the same size.
+int maxChannelDifference(const QImage &a, const QImage &b, QPoint *where)
+{
+    int worst = 0;
+    for (int y = 0; y < a.height(); ++y) {
+        const QRgb *la = reinterpret_cast<const QRgb *>(a.constScanLine(y));
+        const QRgb *lb = reinterpret_cast<const QRgb *>(b.constScanLine(y));
+        for (int x = 0; x < a.width(); ++x) {
+            const int d = qMax(qMax(qAbs(qAlpha(la[x]) - qAlpha(lb[x])), qAbs(qRed(la[x]) - qRed(lb[x]))),
+                               qMax(qAbs(qGreen(la[x]) - qGreen(lb[x])), qAbs(qBlue(la[x]) - qBlue(lb[x]))));
+            if (d > worst) {
+                worst = d;
+                *where = QPoint(x, y);
+            }
+        }
+    }
+    return worst;
+}
+
+QImage softwareFill(const Shape &s, qreal scale, const QPointF &offset, FillRasterizer::Simd simd)
+{
+    QImage image = fillBackdrop();
+    FillRasterizer fills;
+    fills.setSimd(simd);
+    fills.begin(&image);
+    fills.setTransform(scale, offset);
+    switch (s.type) {
+    case ShapeType::Rect:
+        fills.fillRect(QRectF(s.rect.x, s.rect.y, s.rect.width, s.rect.height), s.fill);
+        break;
+    case ShapeType::FilledCircle:
+        fills.fillCircle(QPointF(s.circle.cx, s.circle.cy), s.circle.radius, s.fill);
+        break;
+    case ShapeType::Triangle:
+        fills.fillTriangle(QPointF(s.triangle.x1, s.triangle.y1), QPointF(s.triangle.x2, s.triangle.y2),
+                           QPointF(s.triangle.x3, s.triangle.y3), s.fill);
+        break;
+    default:
+        break;
+    }
+    return image;
+}
+
+// Renders rects, circles and triangles through SceneRenderer's QPainter
+// reference path and through FillRasterizer at every SIMD level the build
+// and the CPU support. Fails if any software fill is more than tolerance levels off in any
+// channel, or if the vector paths disagree with the scalar one at all.
+int runFillComparison(int tolerance)
+{
+    QVector<Shape> shapes;
+    for (int alpha : { 255, 140 }) {
+        const QRgb color = qPremultiply(qRgba(40, 180, 230, alpha));
+        shapes.append(Shape::makeRect(QRectF(4, 4, 20, 12), color, 0, 1));
+        shapes.append(Shape::makeRect(QRectF(3.3, 5.7, 17.45, 9.2), color, 0, 1));
+        shapes.append(Shape::makeRect(QRectF(10.6, 2.2, 0.4, 24.9), color, 0, 1));
+        shapes.append(Shape::makeFilledCircle(QPointF(16, 16), 10, color));
+        shapes.append(Shape::makeFilledCircle(QPointF(14.3, 17.8), 11.35, color));
+        shapes.append(Shape::makeFilledCircle(QPointF(6.5, 7.25), 1.5, color));
+        shapes.append(Shape::makeTriangle(QPointF(3, 3), QPointF(30, 8), QPointF(9, 28), color, 0, 1));
+        shapes.append(Shape::makeTriangle(QPointF(2.4, 25.1), QPointF(27.9, 24.3), QPointF(15.2, 3.6), color, 0, 1));
+        shapes.append(Shape::makeTriangle(QPointF(2, 2), QPointF(30, 4.5), QPointF(3, 5), color, 0, 1));
+    }
+
+    struct View
+    {
+        qreal   scale;
+        QPointF offset;
+    };
+    const View views[] = { { 1.0, QPointF() }, { 1.0, QPointF(0.3, 0.7) }, { 2.7, QPointF(1.5, 0.25) } };
+
+    QVector<FillRasterizer::Simd> levels;
+    levels << FillRasterizer::Simd::None;
+    if (FillRasterizer::supportedSimd() >= FillRasterizer::Simd::Sse2)
+        levels << FillRasterizer::Simd::Sse2;
+    if (FillRasterizer::supportedSimd() >= FillRasterizer::Simd::Avx2)
+        levels << FillRasterizer::Simd::Avx2;
+    const char *const levelNames[] = { "scalar", "sse2", "avx2" };
+
+    QTextStream &stream = out();
+    int worst[3] = { 0, 0, 0 };
+    int failures = 0;
+    for (const Shape &shape : shapes) {
+        for (const View &view : views) {
+            QImage reference = fillBackdrop();
+            QPainter painter(&reference);
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.setTransform(QTransform(view.scale, 0, 0, view.scale, view.offset.x(), view.offset.y()));
+            SceneRenderer::drawShape(painter, shape);
+            painter.end();
+
+            const QImage scalar = softwareFill(shape, view.scale, view.offset, FillRasterizer::Simd::None);
+            QPoint where;
+            const int difference = maxChannelDifference(scalar, reference, &where);
+            const int kind = shape.type == ShapeType::Rect ? 0 : shape.type == ShapeType::FilledCircle ? 1 : 2;
+            worst[kind] = qMax(worst[kind], difference);
+            if (difference > tolerance) {
+                ++failures;
+                stream << "shape " << (&shape - shapes.constData()) << " at scale " << view.scale
+                       << ": " << difference << " levels off QPainter at " << where.x() << ','
+                       << where.y() << Qt::endl;
+            }
+
+            for (FillRasterizer::Simd level : levels) {
+                if (level == FillRasterizer::Simd::None)
+                    continue;
+                if (maxChannelDifference(softwareFill(shape, view.scale, view.offset, level), scalar, &where) != 0) {
+                    ++failures;
+                    stream << "shape " << (&shape - shapes.constData()) << " at scale " << view.scale
+                           << ": " << levelNames[int(level)] << " differs from scalar at " << where.x()
+                           << ',' << where.y() << Qt::endl;
+                }
+            }
+        }
+    }
+
+    QStringList checked;
+    for (FillRasterizer::Simd level : levels)
+        checked << QLatin1String(levelNames[int(level)]);
+    stream << "Max difference from QPainter (tolerance " << tolerance << "): rects " << worst[0]
+           << ", circles " << worst[1] << ", triangles " << worst[2] << "; paths checked: "
+           << checked.join(QStringLiteral(", ")) << Qt::endl;
+    stream << (failures == 0 ? "Fills match." : "Fills differ.") << Qt::endl;
+    return failures == 0 ? 0 : 1;
+}
+
+// Everything one thread needs to turn a script into an image. Constructed on
+// the thread that uses it so the QObjects and the engine live there.
+class HeadlessWorker
+{
+public:
+    HeadlessWorker(int id, const QSize &size, int pngQuality, bool serialTiles,
+                   ScriptEngineKind engine, bool compareEngines)
+        : m_canvas(&m_state)
+        , m_id(id)
+        , m_size(size)
+        , m_pngQuality(pngQuality)
+        , m_runs(0)
+        , m_defaultEngine(engine)
+        , m_compareEngines(compareEngines)
+    {
+        if (serialTiles)
+            m_renderer.setParallelThreshold(std::numeric_limits<int>::max());
+        // Undo history is useless here; runs hand their capture over as is.
+        m_state.setUndoEnabled(false);
+
+        // Nobody watches the canvas; script output goes to the log instead.
+        QObject::connect(&m_canvas, &ScriptCanvas::message, [id](const QString &message) {
+            qCInfo(lcHeadless) << "Worker" << id << "script print:" << message;
+        });
+    }
+
+    HeadlessRunner::RunStats run(const HeadlessRunner::Job &job);
+
+private:
+    IScriptEngine *engine(ScriptEngineKind kind);
+    // Evaluates code from a clean canvas; returns false with *error set if
+    // the script threw.
+    bool evaluate(ScriptEngineKind kind, const QString &code, const QString &script, QString *error);
+    // Describes the first difference between the current canvas and
+    // reference, or returns an empty string if they match.
+    QString compareLayers(const QVector<QPair<QString, ShapeList>> &reference) const;
+
+    CanvasState    m_state;
+    ScriptCanvas   m_canvas;
+    CanvasRenderer m_renderer;
+    QScopedPointer<IScriptEngine> m_qtScriptEngine;
+    QScopedPointer<IScriptEngine> m_jsEngine;
+    int            m_id;
+    QSize          m_size;
+    int            m_pngQuality;
+    int            m_runs;
+    ScriptEngineKind m_defaultEngine;
+    bool           m_compareEngines;
+};
+
+IScriptEngine *HeadlessWorker::engine(ScriptEngineKind kind)
+{
+    QScopedPointer<IScriptEngine> &slot = kind == ScriptEngineKind::QJSEngine ? m_jsEngine : m_qtScriptEngine;
+    if (!slot)
+        slot.reset(createScriptEngine(kind, &m_canvas));
+    return slot.data();
+}
+
+bool HeadlessWorker::evaluate(ScriptEngineKind kind, const QString &code, const QString &script, QString *error)
+{
+    // Drops the previous run's layers, and with them the last reference to
+    // the capture, so the next capture reuses its storage.
+    m_state.reset();
+    m_canvas.setImageDirectory(QFileInfo(script).absolutePath());
+    m_canvas.beginRun();
+
+    IScriptEngine *scriptEngine = engine(kind);
+    m_state.beginBatch();
+    const bool ok = scriptEngine->evaluate(code, QFileInfo(script).fileName());
+    m_canvas.endOpenBatches();
+    m_canvas.endRun();
+    m_state.endBatch();
+
+    if (!ok) {
+        *error = QStringLiteral("%1 line %2: %3")
+                     .arg(scriptEngineName(kind))
+                     .arg(scriptEngine->errorLine())
+                     .arg(scriptEngine->errorMessage());
+    }
+    return ok;
+}
+
+QString HeadlessWorker::compareLayers(const QVector<QPair<QString, ShapeList>> &reference) const
+{
+    if (m_state.layerCount() != reference.size())
+        return QStringLiteral("%1 layers instead of %2").arg(m_state.layerCount()).arg(reference.size());
+
+    for (int layer = 0; layer < reference.size(); ++layer) {
+        const ShapeList &expected = reference.at(layer).second;
+        const ShapeList &actual = m_state.shapes(layer);
+        if (m_state.layerName(layer) != reference.at(layer).first)
+            return QStringLiteral("layer %1 is named '%2' instead of '%3'")
+                .arg(layer).arg(m_state.layerName(layer), reference.at(layer).first);
+        if (actual.size() != expected.size())
+            return QStringLiteral("layer '%1' has %2 shapes instead of %3")
+                .arg(reference.at(layer).first).arg(actual.size()).arg(expected.size());
+        for (int i = 0; i < actual.size(); ++i) {
+            if (!actual.sameShape(i, expected, i))
+                return QStringLiteral("layer '%1' differs at shape %2").arg(reference.at(layer).first).arg(i);
+        }
+    }
+    return QString();
+}
+
+HeadlessRunner::RunStats HeadlessWorker::run(const HeadlessRunner::Job &job)
+{
+    HeadlessRunner::RunStats stats;
+    stats.script = job.script;
+    stats.worker = m_id;
+    stats.ok = false;
+    stats.shapes = 0;
+    stats.evalNs = 0;
+    stats.renderNs = 0;
+    stats.saveNs = 0;
+
+    QFile file(job.script);
+    if (!file.open(QIODevice::ReadOnly)) {
+        stats.error = file.errorString();
+        return stats;
+    }
+    const QString code = QString::fromUtf8(file.readAll());
+
+    if (++m_runs % kGcInterval == 0) {
+        if (m_qtScriptEngine)
+            m_qtScriptEngine->collectGarbage();
+        if (m_jsEngine)
+            m_jsEngine->collectGarbage();
+    }
+
+    // A "// engine:" header in the script wins over --engine.
+    const ScriptEngineKind kind = scriptEngineForScript(code, m_defaultEngine);
+
+    // The conformance check runs the other backend first and keeps its
+    // output; the timed run below is then compared against it.
+    QVector<QPair<QString, ShapeList>> reference;
+    QColor referenceBackground;
+    qreal referenceZoom = 1.0;
+    const ScriptEngineKind other = kind == ScriptEngineKind::QtScript ? ScriptEngineKind::QJSEngine
+                                                                      : ScriptEngineKind::QtScript;
+    if (m_compareEngines) {
+        if (!evaluate(other, code, job.script, &stats.error))
+            return stats;
+        for (int layer = 0; layer < m_state.layerCount(); ++layer)
+            reference.append(qMakePair(m_state.layerName(layer), m_state.shapes(layer)));
+        referenceBackground = m_state.backgroundColor();
+        referenceZoom = m_state.zoomFactor();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool evaluated = evaluate(kind, code, job.script, &stats.error);
+    stats.evalNs = timer.nsecsElapsed();
+    stats.shapes = m_state.shapeCount();
+    if (!evaluated)
+        return stats;
+
+    if (m_compareEngines) {
+        QString mismatch = compareLayers(reference);
+        if (mismatch.isEmpty() && m_state.backgroundColor() != referenceBackground)
+            mismatch = QStringLiteral("background is %1 instead of %2")
+                           .arg(m_state.backgroundColor().name(QColor::HexArgb), referenceBackground.name(QColor::HexArgb));
+        if (mismatch.isEmpty() && !qFuzzyCompare(m_state.zoomFactor(), referenceZoom))
+            mismatch = QStringLiteral("zoom is %1 instead of %2").arg(m_state.zoomFactor()).arg(referenceZoom);
+        if (!mismatch.isEmpty()) {
+            stats.error = QStringLiteral("%1 and %2 differ: %3")
+                              .arg(scriptEngineName(kind), scriptEngineName(other), mismatch);
+            return stats;
+        }
+    }
+
+    timer.restart();
+    const QImage image = m_renderer.render(m_state, m_size);
+    stats.renderNs = timer.nsecsElapsed();
+
+    timer.restart();
+    if (!image.save(job.target, "PNG", m_pngQuality)) {
+        stats.error = QStringLiteral("cannot write %1").arg(job.target);
+        return stats;
+    }
+    stats.saveNs = timer.nsecsElapsed();
+
+    stats.ok = true;
+    return stats;
+}
+
+// One deque of job indices per worker. Owners pop from the front; a worker
+// whose deque is empty steals from the back of the others, so a run of slow
+// scripts in one share does not leave the remaining cores idle.
+class WorkQueues
+{
+public:
+    WorkQueues(int jobCount, int workerCount)
+        : m_slots(workerCount)
+    {
+        // Contiguous shares keep similar neighbouring scripts on one worker.
+        for (int w = 0; w < workerCount; ++w) {
+            const int first = int(qint64(jobCount) * w / workerCount);
+            const int last = int(qint64(jobCount) * (w + 1) / workerCount);
+            for (int i = first; i < last; ++i)
+                m_slots[w].jobs.push_back(i);
+        }
+    }
+
+    bool take(int worker, int *job)
+    {
+        {
+            Slot &own = m_slots[worker];
+            QMutexLocker locker(&own.lock);
+            if (!own.jobs.empty()) {
+                *job = own.jobs.front();
+                own.jobs.pop_front();
+                return true;
+            }
+        }
+
+        // Nothing is ever pushed after start, so a full sweep that finds
+        // every deque empty means the batch is done.
+        const int count = int(m_slots.size());
+        for (int step = 1; step < count; ++step) {
+            Slot &victim = m_slots[(worker + step) % count];
+            QMutexLocker locker(&victim.lock);
+            if (!victim.jobs.empty()) {
+                *job = victim.jobs.back();
+                victim.jobs.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Slot
+    {
+        QMutex          lock;
+        std::deque<int> jobs;
+    };
+
+    std::vector<Slot> m_slots;
+};
+
+// Collects results from all workers and appends them to the stats file as
+// they arrive, so a long batch can be watched (or salvaged) while running.
+class ResultSink
+{
+public:
+    ResultSink()
+        : m_failures(0)
+    {
+    }
+
+    bool open(const QString &path)
+    {
+        if (path.isEmpty())
+            return true;
+
+        m_file.setFileName(path);
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+            return false;
+        m_stream.setDevice(&m_file);
+        m_stream << "script,worker,status,shapes,eval_ms,render_ms,save_ms,error\n";
+        m_stream.flush();
+        return true;
+    }
+
+    void add(const HeadlessRunner::RunStats &run)
+    {
+        QMutexLocker locker(&m_lock);
+        if (!run.ok) {
+            ++m_failures;
+            err() << run.script << ": " << run.error << Qt::endl;
+        }
+        if (!m_file.isOpen())
+            return;
+
+        QString error = run.error;
+        error.replace(QLatin1Char('"'), QStringLiteral("\"\""));
+        m_stream << '"' << run.script << "\","
+                 << run.worker << ','
+                 << (run.ok ? "ok" : "failed") << ','
+                 << run.shapes << ','
+                 << QString::number(toMs(run.evalNs), 'f', 3) << ','
+                 << QString::number(toMs(run.renderNs), 'f', 3) << ','
+                 << QString::number(toMs(run.saveNs), 'f', 3) << ",\""
+                 << error << "\"\n";
+        m_stream.flush();
+    }
+
+    int failures() const
+    {
+        return m_failures;
+    }
+
+private:
+    QMutex      m_lock;
+    QFile       m_file;
+    QTextStream m_stream;
+    int         m_failures;
+};
+
+void runWorker(int id, const QVector<HeadlessRunner::Job> &jobs, const QSize &size, int pngQuality,
+               bool serialTiles, ScriptEngineKind engine, bool compareEngines,
+               WorkQueues *queues, ResultSink *sink)
+{
+    HeadlessWorker worker(id, size, pngQuality, serialTiles, engine, compareEngines);
+    int job = 0;
+    while (queues->take(id, &job))
+        sink->add(worker.run(jobs.at(job)));
+}
+
+} // namespace
+
+HeadlessRunner::HeadlessRunner()
+    : m_size(kDefaultSize)
+    , m_pngQuality(-1)
+    , m_workerCount(1)
+    , m_benchmarkCalls(0)
+    , m_fillTolerance(-1)
+    , m_engine(ScriptEngineKind::QtScript)
+    , m_compareEngines(false)
+{
+}
+
+bool HeadlessRunner::parseArguments(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Renders scripts to PNG images without a window."));
+    parser.addHelpOption();
+
+    QCommandLineOption headlessOption(QStringLiteral("headless"),
+                                      QStringLiteral("Run without a window (required for this mode)."));
+    QCommandLineOption outputOption(QStringList() << QStringLiteral("o") << QStringLiteral("output"),
+                                    QStringLiteral("Directory for the rendered images."),
+                                    QStringLiteral("dir"), QStringLiteral("."));
+    QCommandLineOption sizeOption(QStringLiteral("size"),
+                                  QStringLiteral("Canvas size in pixels, e.g. 480x360."),
+                                  QStringLiteral("WxH"));
+    QCommandLineOption qualityOption(QStringLiteral("png-quality"),
+                                     QStringLiteral("PNG quality 0-100; higher compresses less and saves faster."),
+                                     QStringLiteral("quality"));
+    QCommandLineOption statsOption(QStringLiteral("stats"),
+                                   QStringLiteral("Stream per-script timings to a CSV file."),
+                                   QStringLiteral("file"));
+    QCommandLineOption jobsOption(QStringList() << QStringLiteral("j") << QStringLiteral("jobs"),
+                                  QStringLiteral("Number of worker threads (default: one per core)."),
+                                  QStringLiteral("count"));
+    QCommandLineOption manifestOption(QStringLiteral("manifest"),
+                                      QStringLiteral("Text file listing scripts, one path per line."),
+                                      QStringLiteral("file"));
+    QCommandLineOption engineOption(QStringLiteral("engine"),
+                                    QStringLiteral("Script engine: qtscript (default) or qjsengine."),
+                                    QStringLiteral("name"), QStringLiteral("qtscript"));
+    QCommandLineOption compareOption(QStringLiteral("compare-engines"),
+                                     QStringLiteral("Also run every script on the other engine and fail on any difference."));
+    QCommandLineOption benchOption(QStringLiteral("bench-bindings"),
+                                   QStringLiteral("Compare native and QObject binding cost per call and exit."));
+    QCommandLineOption callsOption(QStringLiteral("bench-calls"),
+                                   QStringLiteral("Calls per binding for --bench-bindings (default 200000)."),
+                                   QStringLiteral("count"), QStringLiteral("200000"));
+    QCommandLineOption fillsOption(QStringLiteral("compare-fills"),
+                                   QStringLiteral("Check the software span fills against QPainter and exit."));
+    QCommandLineOption toleranceOption(QStringLiteral("fill-tolerance"),
+                                       QStringLiteral("Largest per-channel difference --compare-fills accepts (default 16)."),
+                                       QStringLiteral("levels"), QStringLiteral("16"));
+    parser.addOption(headlessOption);
+    parser.addOption(outputOption);
+    parser.addOption(sizeOption);
+    parser.addOption(qualityOption);
+    parser.addOption(statsOption);
+    parser.addOption(jobsOption);
+    parser.addOption(manifestOption);
+    parser.addOption(engineOption);
+    parser.addOption(compareOption);
+    parser.addOption(benchOption);
+    parser.addOption(callsOption);
+    parser.addOption(fillsOption);
+    parser.addOption(toleranceOption);
+    parser.addPositionalArgument(QStringLiteral("paths"),
+                                 QStringLiteral("Script files, or directories searched for *.qs and *.js."),
+                                 QStringLiteral("paths..."));
+
+    parser.process(arguments);
+
+    if (parser.isSet(benchOption)) {
+        bool ok = false;
+        m_benchmarkCalls = parser.value(callsOption).toInt(&ok);
+        if (!ok || m_benchmarkCalls <= 0) {
+            err() << "Invalid --bench-calls: " << parser.value(callsOption) << Qt::endl;
+            return false;
+        }
+        return true;
+    }
+
+    if (parser.isSet(fillsOption)) {
+        bool ok = false;
+        m_fillTolerance = parser.value(toleranceOption).toInt(&ok);
+        if (!ok || m_fillTolerance < 0 || m_fillTolerance > 255) {
+            err() << "Invalid --fill-tolerance: " << parser.value(toleranceOption) << Qt::endl;
+            return false;
+        }
+        return true;
+    }
+
+    if (parser.isSet(sizeOption)) {
+        const QStringList parts = parser.value(sizeOption).split(QLatin1Char('x'));
+        bool okWidth = false;
+        bool okHeight = false;
+        const int width = parts.size() == 2 ? parts.at(0).toInt(&okWidth) : 0;
+        const int height = parts.size() == 2 ? parts.at(1).toInt(&okHeight) : 0;
+        if (!okWidth || !okHeight || width <= 0 || height <= 0) {
+            err() << "Invalid --size: " << parser.value(sizeOption) << Qt::endl;
+            return false;
+        }
+        m_size = QSize(width, height);
+    }
+
+    if (parser.isSet(qualityOption)) {
+        bool ok = false;
+        m_pngQuality = parser.value(qualityOption).toInt(&ok);
+        if (!ok || m_pngQuality < 0 || m_pngQuality > 100) {
+            err() << "Invalid --png-quality: " << parser.value(qualityOption) << Qt::endl;
+            return false;
+        }
+    }
+
+    m_workerCount = qMax(1, QThread::idealThreadCount());
+    if (parser.isSet(jobsOption)) {
+        bool ok = false;
+        m_workerCount = parser.value(jobsOption).toInt(&ok);
+        if (!ok || m_workerCount <= 0) {
+            err() << "Invalid --jobs: " << parser.value(jobsOption) << Qt::endl;
+            return false;
+        }
+    }
+
+    m_outputDir = QDir(parser.value(outputOption));
+    if (!m_outputDir.exists() && !m_outputDir.mkpath(QStringLiteral("."))) {
+        err() << "Cannot create output directory " << m_outputDir.path() << Qt::endl;
+        return false;
+    }
+
+    if (!scriptEngineKindFromName(parser.value(engineOption), &m_engine)) {
+        err() << "Invalid --engine: " << parser.value(engineOption) << Qt::endl;
+        return false;
+    }
+    m_compareEngines = parser.isSet(compareOption);
+
+    m_statsPath = parser.value(statsOption);
+
+    QStringList scripts;
+    if (parser.isSet(manifestOption) && !readManifest(parser.value(manifestOption), &scripts)) {
+        err() << "Cannot read manifest " << parser.value(manifestOption) << Qt::endl;
+        return false;
+    }
+    scripts.append(collectScripts(parser.positionalArguments()));
+    if (scripts.isEmpty()) {
+        err() << "No scripts given." << Qt::endl;
+        parser.showHelp(1);
+    }
+    assignTargets(scripts);
+    return true;
+}
+
+int HeadlessRunner::exec()
+{
+    if (m_benchmarkCalls > 0)
+        return runBindingBenchmark(m_benchmarkCalls);
+    if (m_fillTolerance >= 0)
+        return runFillComparison(m_fillTolerance);
+
+    ResultSink sink;
+    if (!sink.open(m_statsPath)) {
+        err() << "Cannot write stats to " << m_statsPath << Qt::endl;
+        return 2;
+    }
+
+    const int workerCount = qMin(m_workerCount, m_jobs.size());
+    WorkQueues queues(m_jobs.size(), workerCount);
+
+    QElapsedTimer total;
+    total.start();
+    if (workerCount == 1) {
+        // A single worker keeps the tile renderer's own parallelism.
+        runWorker(0, m_jobs, m_size, m_pngQuality, false, m_engine, m_compareEngines, &queues, &sink);
+    } else {
+        QVector<QThread *> threads;
+        for (int id = 0; id < workerCount; ++id) {
+            QThread *thread = QThread::create([this, id, &queues, &sink]() {
+                runWorker(id, m_jobs, m_size, m_pngQuality, true, m_engine, m_compareEngines, &queues, &sink);
+            });
+            thread->start();
+            threads.append(thread);
+        }
+        for (QThread *thread : threads) {
+            thread->wait();
+            delete thread;
+        }
+    }
+    const qint64 totalNs = total.nsecsElapsed();
+
+    const double seconds = qMax(totalNs, qint64(1)) / 1.0e9;
+    out() << m_jobs.size() << " scripts on " << workerCount << " workers, "
+          << sink.failures() << " failed, "
+          << QString::number(toMs(totalNs), 'f', 1) << " ms total ("
+          << QString::number(m_jobs.size() * 60.0 / seconds, 'f', 0) << " scenes/min)" << Qt::endl;
+
+    return sink.failures() > 0 ? 1 : 0;
+}
+
+QStringList HeadlessRunner::collectScripts(const QStringList &paths)
+{
+    QStringList scripts;
+    for (const QString &path : paths) {
+        if (!QFileInfo(path).isDir()) {
+            scripts.append(path);
+            continue;
+        }
+
+        // Sorted so the job order, and with it the work split, is reproducible.
+        QStringList found;
+        QDirIterator it(path, QStringList() << QStringLiteral("*.qs") << QStringLiteral("*.js"),
+                        QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext())
+            found.append(it.next());
+        found.sort();
+        scripts.append(found);
+    }
+    return scripts;
+}
+
+bool HeadlessRunner::readManifest(const QString &path, QStringList *scripts)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+
+    // Relative entries are resolved against the manifest's own directory.
+    const QDir base = QFileInfo(path).absoluteDir();
+    QStringList entries;
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        const QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#')))
+            continue;
+        entries.append(base.filePath(line));
+    }
+    scripts->append(collectScripts(entries));
+    return true;
+}
+
+void HeadlessRunner::assignTargets(const QStringList &scripts)
+{
+    // Workers write concurrently, so two scripts must never share an image.
+    QSet<QString> used;
+    m_jobs.clear();
+    m_jobs.reserve(scripts.size());
+    for (const QString &script : scripts) {
+        const QString base = QFileInfo(script).completeBaseName();
+        QString name = base;
+        // Compared case-insensitively for the benefit of Windows file systems.
+        for (int n = 2; used.contains(name.toLower()); ++n)
+            name = QStringLiteral("%1_%2").arg(base).arg(n);
+        used.insert(name.toLower());
+
+        Job job;
+        job.script = script;
+        job.target = m_outputDir.filePath(name + QStringLiteral(".png"));
+        m_jobs.append(job);
+    }
+}
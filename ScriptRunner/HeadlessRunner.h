@@ -0,0 +1,80 @@
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include <QDir>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+#include "IScriptEngine.h"
+
+// Command line front end that evaluates script files without a window and
+// writes every resulting canvas to a PNG, plus per-script timings:
+//
+//   ScriptRunner --headless [--output DIR] [--size WxH] [--stats FILE]
+//                [--jobs N] [--manifest FILE] [--engine NAME]
+//                [--compare-engines] PATH...
+//   ScriptRunner --headless --bench-bindings [--bench-calls N]
+//   ScriptRunner --headless --compare-fills [--fill-tolerance N]
+//
+// Scripts run on a pool of worker threads. Each worker owns its engine,
+// canvas state and renderer; jobs start in per-worker deques and idle
+// workers steal from the others. Timings are streamed to the stats file as
+// each script finishes.
+//
+// --compare-engines is the conformance check between the backends: every
+// script also runs on the engine it did not pick, and fails unless both
+// produce identical shapes on identical layers, background and zoom. The
+// corpus in ScriptRunner/conformance calls every canvas and Qt function;
+// running it with --jobs 1 --compare-engines is the check to pass before
+// changing either backend or the bindings.
+//
+// --compare-fills checks FillRasterizer against the QPainter path it
+// replaces, for every SIMD level the build and the CPU support.
+class HeadlessRunner
+{
+public:
+    HeadlessRunner();
+
+    // Returns false after printing a usage error.
+    bool parseArguments(const QStringList &arguments);
+    // Runs every script. The exit code is non-zero if any of them failed.
+    int exec();
+
+    struct Job
+    {
+        QString script;
+        QString target;
+    };
+
+    struct RunStats
+    {
+        QString script;
+        int     worker;
+        bool    ok;
+        int     shapes;
+        qint64  evalNs;
+        qint64  renderNs;
+        qint64  saveNs;
+        QString error;
+    };
+
+private:
+    static QStringList collectScripts(const QStringList &paths);
+    static bool readManifest(const QString &path, QStringList *scripts);
+    void assignTargets(const QStringList &scripts);
+
+    QVector<Job> m_jobs;
+    QDir         m_outputDir;
+    QSize        m_size;
+    int          m_pngQuality;
+    int          m_workerCount;
+    int          m_benchmarkCalls;
+    // Set (>= 0) for --compare-fills.
+    int          m_fillTolerance;
+    QString      m_statsPath;
+    ScriptEngineKind m_engine;
+    bool         m_compareEngines;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include "IScriptEngine.h"
+
+#include "JsEngineBackend.h"
+#include "QtScriptBackend.h"
+
+#include <QRegularExpression>
+
+bool scriptEngineKindFromName(const QString &name, ScriptEngineKind *kind)
+{
+    const QString key = name.trimmed().toLower();
+    if (key == QLatin1String("qtscript")) {
+        *kind = ScriptEngineKind::QtScript;
+        return true;
+    }
+    if (key == QLatin1String("qjsengine") || key == QLatin1String("qjs")) {
+        *kind = ScriptEngineKind::QJSEngine;
+        return true;
+    }
+    return false;
+}
+
+QString scriptEngineName(ScriptEngineKind kind)
+{
+    switch (kind) {
+    case ScriptEngineKind::QtScript:
+        return QStringLiteral("qtscript");
+    case ScriptEngineKind::QJSEngine:
+        return QStringLiteral("qjsengine");
+    }
+    return QString();
+}
+
+ScriptEngineKind scriptEngineForScript(const QString &code, ScriptEngineKind fallback)
+{
+    static const QRegularExpression header(QStringLiteral("^//\\s*engine\\s*:\\s*(\\S+)\\s*$"),
+                                           QRegularExpression::CaseInsensitiveOption);
+
+    // Only the comment block at the very top counts, so the first statement
+    // ends the search and long scripts are not scanned.
+    int start = 0;
+    while (start < code.size()) {
+        int end = code.indexOf(QLatin1Char('\n'), start);
+        if (end < 0)
+            end = code.size();
+        const QString line = code.mid(start, end - start).trimmed();
+        start = end + 1;
+        if (line.isEmpty())
+            continue;
+        if (!line.startsWith(QLatin1String("//")))
+            break;
+
+        const QRegularExpressionMatch match = header.match(line);
+        ScriptEngineKind kind;
+        if (match.hasMatch() && scriptEngineKindFromName(match.captured(1), &kind))
+            return kind;
+    }
+    return fallback;
+}
+
+IScriptEngine *createScriptEngine(ScriptEngineKind kind, ScriptCanvas *canvas)
+{
+    switch (kind) {
+    case ScriptEngineKind::QtScript:
+        return new QtScriptBackend(canvas);
+    case ScriptEngineKind::QJSEngine:
+        return new JsEngineBackend(canvas);
+    }
+    return nullptr;
+}
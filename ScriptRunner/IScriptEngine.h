@@ -0,0 +1,44 @@
+#ifndef ISCRIPTENGINE_H
+#define ISCRIPTENGINE_H
+
+#include <QString>
+
+class ScriptCanvas;
+
+// Which engine evaluates a script. Both expose the same `canvas` object and
+// `Qt.rgba`/`Qt.color` helpers, so a script runs unchanged on either.
+enum class ScriptEngineKind
+{
+    QtScript,   // QScriptEngine: interpreter with the native drawing calls
+    QJSEngine   // QJSEngine: JIT compiled, faster for math-heavy scripts
+};
+
+// Abstract engine so the runners evaluate scripts without caring which
+// backend is behind them. One instance drives one ScriptCanvas and is used
+// from a single thread.
+class IScriptEngine
+{
+public:
+    virtual ~IScriptEngine() = default;
+
+    virtual ScriptEngineKind kind() const = 0;
+    // Evaluates one run. Globals a script defines do not survive into the
+    // next call. Returns false on an uncaught exception, described by
+    // errorLine() and errorMessage() until the next call.
+    virtual bool evaluate(const QString &code, const QString &fileName) = 0;
+    virtual int errorLine() const = 0;
+    virtual QString errorMessage() const = 0;
+    // Reclaims what earlier runs left behind; call while nothing runs.
+    virtual void collectGarbage() = 0;
+};
+
+// "qtscript" or "qjsengine" (also "qjs"), case-insensitive.
+bool scriptEngineKindFromName(const QString &name, ScriptEngineKind *kind);
+QString scriptEngineName(ScriptEngineKind kind);
+// The engine a script asks for with a "// engine: <name>" line among its
+// leading comment lines, or fallback if it does not ask.
+ScriptEngineKind scriptEngineForScript(const QString &code, ScriptEngineKind fallback);
+// The caller owns the engine; canvas must outlive it.
+IScriptEngine *createScriptEngine(ScriptEngineKind kind, ScriptCanvas *canvas);
+
+#endif
@@ -0,0 +1,187 @@
+#include "JsEngineBackend.h"
+
+#include "ColorTable.h"
+#include "ScriptCanvas.h"
+
+#include <QColor>
+
+namespace {
+
+// Mirrors the function objects installScriptBindings() creates: too few
+// arguments yield undefined instead of an exception.
+const char kQtNamespace[] =
+    "(function (helpers) {\n"
+    "    return {\n"
+    "        rgba: function (r, g, b, a) {\n"
+    "            if (arguments.length < 3)\n"
+    "                return undefined;\n"
+    "            return helpers.rgba(Number(r), Number(g), Number(b), arguments.length >= 4 ? Number(a) : 1.0);\n"
+    "        },\n"
+    "        color: function (name) {\n"
+    "            if (arguments.length < 1)\n"
+    "                return undefined;\n"
+    "            return helpers.color(String(name));\n"
+    "        }\n"
+    "    };\n"
+    "})";
+
+// Called once the bindings are installed; returns the function that puts
+// them back after a run. Snapshots the own properties (as descriptors, so
+// non-enumerable built-ins count too) of the global object, of every object
+// a global name leads to except the canvas wrapper, and of the
+// constructors' prototypes. The restore function only uses what it
+// captured here, since a script may have replaced anything else.
+const char kIsolation[] =
+    "(function (global, canvas) {\n"
+    "    var names = Object.getOwnPropertyNames;\n"
+    "    var describe = Object.getOwnPropertyDescriptor;\n"
+    "    var define = Object.defineProperty;\n"
+    "    var same = Object.is;\n"
+    "    var owns = Function.prototype.call.bind(Object.prototype.hasOwnProperty);\n"
+    "    var objects = [];\n"
+    "    function add(value) {\n"
+    "        if (value === null || value === canvas || (typeof value !== 'object' && typeof value !== 'function'))\n"
+    "            return;\n"
+    "        if (objects.indexOf(value) < 0)\n"
+    "            objects.push(value);\n"
+    "    }\n"
+    "    add(global);\n"
+    "    names(global).forEach(function (name) {\n"
+    "        var value = describe(global, name).value;\n"
+    "        add(value);\n"
+    "        if (typeof value === 'function' && owns(value, 'prototype'))\n"
+    "            add(describe(value, 'prototype').value);\n"
+    "    });\n"
+    "    // Descriptors without a prototype: defineProperty() reads inherited\n"
+    "    // fields too, and Object.prototype may be polluted at restore time.\n"
+    "    function detached(descriptor) {\n"
+    "        var copy = Object.create(null);\n"
+    "        for (var field in descriptor)\n"
+    "            copy[field] = descriptor[field];\n"
+    "        return copy;\n"
+    "    }\n"
+    "    var snapshots = objects.map(function (object) {\n"
+    "        var saved = Object.create(null);\n"
+    "        var keys = names(object);\n"
+    "        for (var i = 0; i < keys.length; ++i)\n"
+    "            saved[keys[i]] = detached(describe(object, keys[i]));\n"
+    "        return { object: object, keys: keys, saved: saved };\n"
+    "    });\n"
+    "    return function () {\n"
+    "        for (var s = 0; s < snapshots.length; ++s) {\n"
+    "            var object = snapshots[s].object;\n"
+    "            var saved = snapshots[s].saved;\n"
+    "            var current = names(object);\n"
+    "            for (var i = 0; i < current.length; ++i) {\n"
+    "                if (!owns(saved, current[i]))\n"
+    "                    delete object[current[i]];\n"
+    "            }\n"
+    "            var keys = snapshots[s].keys;\n"
+    "            for (var k = 0; k < keys.length; ++k) {\n"
+    "                var was = saved[keys[k]];\n"
+    "                var is = describe(object, keys[k]);\n"
+    "                if (is && same(is.value, was.value) && is.get === was.get && is.set === was.set\n"
+    "                    && is.writable === was.writable && is.enumerable === was.enumerable)\n"
+    "                    continue;\n"
+    "                try {\n"
+    "                    define(object, keys[k], was);\n"
+    "                } catch (e) {\n"
+    "                }\n"
+    "            }\n"
+    "        }\n"
+    "    };\n"
+    "})";
+
+} // namespace
+
+JsQtHelpers::JsQtHelpers(QObject *parent)
+    : QObject(parent)
+{
+}
+
+QVariant JsQtHelpers::rgba(qreal r, qreal g, qreal b, qreal a) const
+{
+    QColor color;
+    color.setRgbF(qBound(0.0, r, 1.0), qBound(0.0, g, 1.0), qBound(0.0, b, 1.0), qBound(0.0, a, 1.0));
+    return color;
+}
+
+QVariant JsQtHelpers::color(const QString &name) const
+{
+    const QColor color = ColorTable::color(name);
+    return color.isValid() ? QVariant(color) : QVariant();
+}
+
+JsEngineBackend::JsEngineBackend(ScriptCanvas *canvas)
+    : m_evaluating(false)
+    , m_errorLine(0)
+{
+    // Both objects are owned on the C++ side; without this the engine would
+    // delete them when their wrappers are collected.
+    QJSEngine::setObjectOwnership(canvas, QJSEngine::CppOwnership);
+    QJSEngine::setObjectOwnership(&m_helpers, QJSEngine::CppOwnership);
+
+    QJSValue global = m_engine.globalObject();
+    const QJSValue canvasObject = m_engine.newQObject(canvas);
+    global.setProperty(QStringLiteral("canvas"), canvasObject);
+    global.setProperty(QStringLiteral("Qt"), m_engine.evaluate(QLatin1String(kQtNamespace))
+                                                 .call(QJSValueList() << m_engine.newQObject(&m_helpers)));
+
+    m_restore = m_engine.evaluate(QLatin1String(kIsolation)).call(QJSValueList() << global << canvasObject);
+
+    // The canvas is shared with the other backend; only the one running the
+    // script may throw.
+    QObject::connect(canvas, &ScriptCanvas::scriptError, &m_engine, [this](const QString &text) {
+        if (m_evaluating)
+            m_engine.throwError(text);
+    });
+}
+
+ScriptEngineKind JsEngineBackend::kind() const
+{
+    return ScriptEngineKind::QJSEngine;
+}
+
+bool JsEngineBackend::evaluate(const QString &code, const QString &fileName)
+{
+    // The wrapper opens on the script's first line, so reported line
+    // numbers match the source. QJSEngine::evaluate() returns whatever was
+    // thrown, which only looks like an error for Error objects (not for
+    // `throw "x"`), so the wrapper catches and boxes it instead.
+    m_evaluating = true;
+    const QJSValue result = m_engine.evaluate(QStringLiteral("(function () { try { (function () {") + code
+                                                  + QStringLiteral("\n})(); } catch (e) { return { thrown: e }; } })();"),
+                                              fileName);
+    m_evaluating = false;
+    m_restore.call();
+
+    // Syntax errors are raised before the wrapper runs.
+    QJSValue thrown = result;
+    if (!result.isError()) {
+        if (!result.isObject()) {
+            m_errorLine = 0;
+            m_errorMessage.clear();
+            return true;
+        }
+        thrown = result.property(QStringLiteral("thrown"));
+    }
+
+    m_errorLine = thrown.isError() ? thrown.property(QStringLiteral("lineNumber")).toInt() : 0;
+    m_errorMessage = thrown.toString();
+    return false;
+}
+
+int JsEngineBackend::errorLine() const
+{
+    return m_errorLine;
+}
+
+QString JsEngineBackend::errorMessage() const
+{
+    return m_errorMessage;
+}
+
+void JsEngineBackend::collectGarbage()
+{
+    m_engine.collectGarbage();
+}
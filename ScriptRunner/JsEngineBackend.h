@@ -0,0 +1,51 @@
+#ifndef JSENGINEBACKEND_H
+#define JSENGINEBACKEND_H
+
+#include "IScriptEngine.h"
+
+#include <QJSEngine>
+#include <QJSValue>
+#include <QObject>
+#include <QVariant>
+
+// Native half of the `Qt` namespace under QJSEngine. A small script wrapper
+// adds the argument checks QtScript's function objects do by hand.
+class JsQtHelpers : public QObject
+{
+    Q_OBJECT
+public:
+    explicit JsQtHelpers(QObject *parent = nullptr);
+
+    Q_INVOKABLE QVariant rgba(qreal r, qreal g, qreal b, qreal a) const;
+    Q_INVOKABLE QVariant color(const QString &name) const;
+};
+
+// QJSEngine backend. The canvas is exposed as a plain QObject wrapper; the
+// JIT makes up for the missing native fast path. Each run is wrapped in a
+// function so declarations stay local. What it still changes on the global
+// object, on the objects globals lead to (Qt, Math, JSON, ...) or on the
+// constructors' prototypes is put back afterwards, as ScriptRunContext does
+// for QtScript. The canvas wrapper itself is not tracked: its properties are
+// the C++ object's.
+class JsEngineBackend : public IScriptEngine
+{
+public:
+    explicit JsEngineBackend(ScriptCanvas *canvas);
+
+    ScriptEngineKind kind() const override;
+    bool evaluate(const QString &code, const QString &fileName) override;
+    int errorLine() const override;
+    QString errorMessage() const override;
+    void collectGarbage() override;
+
+private:
+    JsQtHelpers m_helpers;
+    QJSEngine   m_engine;
+    // Script function undoing a run's changes to the baseline.
+    QJSValue    m_restore;
+    bool        m_evaluating;
+    int         m_errorLine;
+    QString     m_errorMessage;
+};
+
+#endif
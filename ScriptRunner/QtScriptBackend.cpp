@@ -0,0 +1,69 @@
+#include "QtScriptBackend.h"
+
+#include "ScriptCanvas.h"
+
+#include <QScriptContext>
+
+namespace {
+
+// The run context snapshots the globals it sees, so the bindings have to be
+// in place before it is constructed.
+QScriptEngine *withBindings(QScriptEngine *engine, ScriptCanvas *canvas)
+{
+    installScriptBindings(engine, canvas);
+    return engine;
+}
+
+} // namespace
+
+QtScriptBackend::QtScriptBackend(ScriptCanvas *canvas)
+    : m_runContext(withBindings(&m_engine, canvas))
+    , m_errorLine(0)
+{
+    // The canvas is shared with the other backend; only the one running the
+    // script may throw.
+    QObject::connect(canvas, &ScriptCanvas::scriptError, &m_engine, [this](const QString &text) {
+        if (m_engine.isEvaluating())
+            m_engine.currentContext()->throwError(text);
+    });
+}
+
+ScriptEngineKind QtScriptBackend::kind() const
+{
+    return ScriptEngineKind::QtScript;
+}
+
+bool QtScriptBackend::evaluate(const QString &code, const QString &fileName)
+{
+    m_runContext.evaluate(code, fileName);
+    if (!m_engine.hasUncaughtException()) {
+        m_errorLine = 0;
+        m_errorMessage.clear();
+        return true;
+    }
+
+    m_errorLine = m_engine.uncaughtExceptionLineNumber();
+    m_errorMessage = m_engine.uncaughtException().toString();
+    m_engine.clearExceptions();
+    return false;
+}
+
+int QtScriptBackend::errorLine() const
+{
+    return m_errorLine;
+}
+
+QString QtScriptBackend::errorMessage() const
+{
+    return m_errorMessage;
+}
+
+void QtScriptBackend::collectGarbage()
+{
+    m_runContext.collectGarbage();
+}
+
+QScriptEngine *QtScriptBackend::engine()
+{
+    return &m_engine;
+}
@@ -0,0 +1,32 @@
+#ifndef QTSCRIPTBACKEND_H
+#define QTSCRIPTBACKEND_H
+
+#include "IScriptEngine.h"
+#include "ScriptBindings.h"
+
+#include <QScriptEngine>
+
+// QScriptEngine with the native bindings from installScriptBindings(); each
+// run is isolated by a ScriptRunContext.
+class QtScriptBackend : public IScriptEngine
+{
+public:
+    explicit QtScriptBackend(ScriptCanvas *canvas);
+
+    ScriptEngineKind kind() const override;
+    bool evaluate(const QString &code, const QString &fileName) override;
+    int errorLine() const override;
+    QString errorMessage() const override;
+    void collectGarbage() override;
+
+    // For attaching a QScriptEngineAgent, e.g. ScriptProfiler.
+    QScriptEngine *engine();
+
+private:
+    QScriptEngine    m_engine;
+    ScriptRunContext m_runContext;
+    int              m_errorLine;
+    QString          m_errorMessage;
+};
+
+#endif
@@ -0,0 +1,322 @@
+#include "ScriptBindings.h"
+
+#include "ColorTable.h"
+#include "ScriptCanvas.h"
+
+#include <QColor>
+#include <QElapsedTimer>
+#include <QScriptContext>
+#include <QScriptEngine>
+#include <QScriptValue>
+#include <QScriptValueIterator>
+#include <QStringList>
+#include <QTextStream>
+
+namespace {
+
+qreal numberArgument(QScriptContext *context, int index, qreal fallback)
+{
+    if (index >= context->argumentCount())
+        return fallback;
+    const QScriptValue value = context->argument(index);
+    return value.isUndefined() ? fallback : value.toNumber();
+}
+
+// Same rules as the QObject overloads: a QColor value (e.g. a Qt.rgba()
+// result) is taken as is; anything else resolves to the QString overload,
+// so it is converted to a string that must name a valid color. Undefined
+// and numbers therefore draw nothing.
+bool colorArgument(QScriptContext *context, int index, QColor *color)
+{
+    const QScriptValue value = context->argument(index);
+    if (value.isVariant() && value.toVariant().userType() == QMetaType::QColor) {
+        *color = value.toVariant().value<QColor>();
+        return true;
+    }
+    *color = ColorTable::color(value.toString());
+    return color->isValid();
+}
+
+// A TypeError, as the QObject wrapper raises for a call it cannot match, so
+// scripts catching it see the same error type either way.
+QScriptValue tooFewArguments(QScriptContext *context, const char *function, int required)
+{
+    return context->throwError(QScriptContext::TypeError,
+                               QStringLiteral("canvas.%1() expects at least %2 arguments")
+                                   .arg(QLatin1String(function)).arg(required));
+}
+
+// Native versions of the hot drawing calls. They read arguments straight off
+// the context and call the QColor overloads, skipping meta-object lookup,
+// overload resolution and QVariant marshalling.
+QScriptValue nativeLine(QScriptContext *context, QScriptEngine *engine, void *data)
+{
+    if (context->argumentCount() < 5)
+        return tooFewArguments(context, "line", 5);
+
+    QColor color;
+    if (colorArgument(context, 4, &color)) {
+        static_cast<ScriptCanvas *>(data)->line(
+            context->argument(0).toNumber(), context->argument(1).toNumber(),
+            context->argument(2).toNumber(), context->argument(3).toNumber(),
+            color, numberArgument(context, 5, 1.0));
+    }
+    return engine->undefinedValue();
+}
+
+QScriptValue nativeRect(QScriptContext *context, QScriptEngine *engine, void *data)
+{
+    if (context->argumentCount() < 6)
+        return tooFewArguments(context, "rect", 6);
+
+    QColor fill;
+    QColor stroke;
+    if (colorArgument(context, 4, &fill) && colorArgument(context, 5, &stroke)) {
+        static_cast<ScriptCanvas *>(data)->rect(
+            context->argument(0).toNumber(), context->argument(1).toNumber(),
+            context->argument(2).toNumber(), context->argument(3).toNumber(),
+            fill, stroke, numberArgument(context, 6, 1.0));
+    }
+    return engine->undefinedValue();
+}
+
+QScriptValue nativeCircle(QScriptContext *context, QScriptEngine *engine, void *data)
+{
+    if (context->argumentCount() < 4)
+        return tooFewArguments(context, "circle", 4);
+
+    QColor stroke;
+    if (colorArgument(context, 3, &stroke)) {
+        static_cast<ScriptCanvas *>(data)->circle(
+            context->argument(0).toNumber(), context->argument(1).toNumber(),
+            context->argument(2).toNumber(), stroke, numberArgument(context, 4, 1.0));
+    }
+    return engine->undefinedValue();
+}
+
+QScriptValue nativeFilledCircle(QScriptContext *context, QScriptEngine *engine, void *data)
+{
+    if (context->argumentCount() < 4)
+        return tooFewArguments(context, "filledCircle", 4);
+
+    QColor fill;
+    if (colorArgument(context, 3, &fill)) {
+        static_cast<ScriptCanvas *>(data)->filledCircle(
+            context->argument(0).toNumber(), context->argument(1).toNumber(),
+            context->argument(2).toNumber(), fill);
+    }
+    return engine->undefinedValue();
+}
+
+QScriptValue nativeTriangle(QScriptContext *context, QScriptEngine *engine, void *data)
+{
+    if (context->argumentCount() < 8)
+        return tooFewArguments(context, "triangle", 8);
+
+    QColor fill;
+    QColor stroke;
+    if (colorArgument(context, 6, &fill) && colorArgument(context, 7, &stroke)) {
+        static_cast<ScriptCanvas *>(data)->triangle(
+            context->argument(0).toNumber(), context->argument(1).toNumber(),
+            context->argument(2).toNumber(), context->argument(3).toNumber(),
+            context->argument(4).toNumber(), context->argument(5).toNumber(),
+            fill, stroke, numberArgument(context, 8, 1.0));
+    }
+    return engine->undefinedValue();
+}
+
+struct BenchmarkCase
+{
+    const char *name;
+    const char *call;
+};
+
+const BenchmarkCase kBenchmarkCases[] = {
+    { "line",         "canvas.line(i, 0, i, 10, 'red', 1);" },
+    { "rect",         "canvas.rect(i, 0, 10, 10, 'red', 'black', 1);" },
+    { "circle",       "canvas.circle(i, 0, 5, 'red', 1);" },
+    { "filledCircle", "canvas.filledCircle(i, 0, 5, 'red');" },
+    { "triangle",     "canvas.triangle(i, 0, i, 10, 10, 0, 'red', 'black', 1);" }
+};
+
+// Nanoseconds spent in `calls` iterations of body, after a short warm-up.
+qint64 timeLoop(QScriptEngine &engine, const QString &body, int calls)
+{
+    QScriptValue loop = engine.evaluate(
+        QStringLiteral("(function (n) { for (var i = 0; i < n; ++i) { %1 } })").arg(body));
+    loop.call(QScriptValue(), QScriptValueList() << qMax(1, calls / 10));
+
+    QElapsedTimer timer;
+    timer.start();
+    loop.call(QScriptValue(), QScriptValueList() << calls);
+    return timer.nsecsElapsed();
+}
+
+} // namespace
+
+int runBindingBenchmark(int calls)
+{
+    QTextStream out(stdout);
+    ScriptCanvas canvas(nullptr);
+
+    QScriptEngine metaEngine;
+    metaEngine.globalObject().setProperty("canvas", metaEngine.newQObject(&canvas));
+    QScriptEngine nativeEngine;
+    installScriptBindings(&nativeEngine, &canvas);
+
+    // The empty loop is subtracted so only the call itself is compared.
+    const qint64 metaLoop = timeLoop(metaEngine, QString(), calls);
+    const qint64 nativeLoop = timeLoop(nativeEngine, QString(), calls);
+
+    out << QStringLiteral("%1 %2 %3 %4")
+               .arg(QStringLiteral("call"), -14)
+               .arg(QStringLiteral("qobject ns"), 12)
+               .arg(QStringLiteral("native ns"), 12)
+               .arg(QStringLiteral("speedup"), 9) << Qt::endl;
+
+    for (const BenchmarkCase &bench : kBenchmarkCases) {
+        const QString body = QLatin1String(bench.call);
+        const qint64 meta = qMax<qint64>(1, timeLoop(metaEngine, body, calls) - metaLoop);
+        const qint64 native = qMax<qint64>(1, timeLoop(nativeEngine, body, calls) - nativeLoop);
+        if (metaEngine.hasUncaughtException() || nativeEngine.hasUncaughtException()) {
+            out << bench.name << ": " << metaEngine.uncaughtException().toString()
+                << nativeEngine.uncaughtException().toString() << Qt::endl;
+            return 1;
+        }
+
+        out << QStringLiteral("%1 %2 %3 %4x")
+                   .arg(QLatin1String(bench.name), -14)
+                   .arg(double(meta) / calls, 12, 'f', 1)
+                   .arg(double(native) / calls, 12, 'f', 1)
+                   .arg(double(meta) / native, 8, 'f', 2) << Qt::endl;
+    }
+    return 0;
+}
+
+void installScriptBindings(QScriptEngine *engine, ScriptCanvas *canvas)
+{
+    // `canvas` is a plain object holding the native functions; everything
+    // else (bulk calls, batches, print, signals) resolves through its
+    // prototype, the regular QObject wrapper.
+    QScriptValue canvasObject = engine->newObject();
+    canvasObject.setPrototype(engine->newQObject(canvas));
+    canvasObject.setProperty("line", engine->newFunction(nativeLine, canvas));
+    canvasObject.setProperty("rect", engine->newFunction(nativeRect, canvas));
+    canvasObject.setProperty("circle", engine->newFunction(nativeCircle, canvas));
+    canvasObject.setProperty("filledCircle", engine->newFunction(nativeFilledCircle, canvas));
+    canvasObject.setProperty("triangle", engine->newFunction(nativeTriangle, canvas));
+    engine->globalObject().setProperty("canvas", canvasObject);
+
+    // Provide a tiny Qt namespace for scripts so they can reuse color helpers.
+    QScriptValue qtObject = engine->newObject();
+    QScriptValue rgbaFunction = engine->newFunction([](QScriptContext *context, QScriptEngine *engine) -> QScriptValue {
+        Q_UNUSED(engine);
+        if (context->argumentCount() >= 3) {
+            const qreal r = context->argument(0).toNumber();
+            const qreal g = context->argument(1).toNumber();
+            const qreal b = context->argument(2).toNumber();
+            const qreal a = context->argumentCount() >= 4 ? context->argument(3).toNumber() : 1.0;
+            QColor color;
+            color.setRgbF(qBound(0.0, r, 1.0), qBound(0.0, g, 1.0), qBound(0.0, b, 1.0), qBound(0.0, a, 1.0));
+            return engine->toScriptValue(color);
+        }
+        return engine->undefinedValue();
+    });
+    qtObject.setProperty("rgba", rgbaFunction);
+
+    QScriptValue colorFunction = engine->newFunction([](QScriptContext *context, QScriptEngine *engine) -> QScriptValue {
+        if (context->argumentCount() >= 1) {
+            const QString colorStr = context->argument(0).toString();
+            const QColor color = ColorTable::color(colorStr);
+            if (color.isValid()) {
+                return engine->toScriptValue(color);
+            }
+        }
+        return engine->undefinedValue();
+    });
+    qtObject.setProperty("color", colorFunction);
+    engine->globalObject().setProperty("Qt", qtObject);
+}
+
+ScriptRunContext::ScriptRunContext(QScriptEngine *engine)
+    : m_engine(engine)
+{
+    const QScriptValue global = m_engine->globalObject();
+    snapshot(global);
+
+    // Everything a global name leads to (canvas, Qt, Math, JSON, the
+    // constructors) and the prototypes the constructors' instances share,
+    // so `canvas.line = ...` or `Array.prototype.x = ...` does not outlive
+    // the run either. QObject wrappers are left out: their members are the
+    // C++ object's, not script state.
+    const QHash<QString, Property> globals = m_snapshots.first().properties;
+    for (const Property &property : globals) {
+        if (!property.value.isObject() || property.value.isQObject())
+            continue;
+        snapshot(property.value);
+        const QScriptValue prototype = property.value.property(QStringLiteral("prototype"));
+        if (prototype.isObject() && !prototype.isQObject())
+            snapshot(prototype);
+    }
+}
+
+QScriptValue ScriptRunContext::evaluate(const QString &code, const QString &fileName)
+{
+    m_engine->pushContext();
+    const QScriptValue result = m_engine->evaluate(code, fileName);
+    m_engine->popContext();
+    restoreGlobals();
+    return result;
+}
+
+void ScriptRunContext::collectGarbage()
+{
+    m_engine->collectGarbage();
+}
+
+void ScriptRunContext::snapshot(const QScriptValue &object)
+{
+    for (const Snapshot &known : qAsConst(m_snapshots)) {
+        if (known.object.strictlyEquals(object))
+            return;
+    }
+
+    // Read-only properties (NaN, undefined, Math.PI, ...) cannot be
+    // overwritten, and accessors compute their value; both are only
+    // recorded by name so restoring leaves them alone.
+    Snapshot snapshot;
+    snapshot.object = object;
+    QScriptValueIterator it(object);
+    while (it.hasNext()) {
+        it.next();
+        const bool fixed = it.flags() & (QScriptValue::ReadOnly | QScriptValue::PropertyGetter
+                                         | QScriptValue::PropertySetter);
+        snapshot.properties.insert(it.name(), { fixed ? QScriptValue() : it.value(), it.flags() });
+    }
+    m_snapshots.append(snapshot);
+}
+
+void ScriptRunContext::restoreGlobals()
+{
+    for (const Snapshot &snapshot : qAsConst(m_snapshots)) {
+        // Collect first: changing properties while iterating is not supported.
+        QStringList added;
+        QScriptValue object = snapshot.object;
+        QScriptValueIterator it(object);
+        while (it.hasNext()) {
+            it.next();
+            if (!snapshot.properties.contains(it.name()))
+                added.append(it.name());
+        }
+        for (const QString &name : added)
+            object.setProperty(name, QScriptValue());
+
+        // Deleted properties come back with their flags, so e.g. a built-in
+        // method does not turn up in for-in loops afterwards.
+        for (auto baseline = snapshot.properties.constBegin(); baseline != snapshot.properties.constEnd(); ++baseline) {
+            const Property &property = baseline.value();
+            if (property.value.isValid() && !object.property(baseline.key()).strictlyEquals(property.value))
+                object.setProperty(baseline.key(), property.value, property.flags);
+        }
+    }
+}
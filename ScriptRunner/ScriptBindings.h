@@ -0,0 +1,66 @@
+#ifndef SCRIPTBINDINGS_H
+#define SCRIPTBINDINGS_H
+
+#include <QHash>
+#include <QScriptValue>
+#include <QString>
+#include <QVector>
+
+class QScriptEngine;
+class ScriptCanvas;
+
+// Installs the globals every runner exposes to scripts: the `canvas` object
+// and the small `Qt` helper namespace. Shared by the window and the headless
+// runner so both evaluate scripts against the same API.
+//
+// The hot drawing calls (line, rect, circle, filledCircle, triangle) are
+// native functions; the QObject wrapper stays behind them as the prototype.
+void installScriptBindings(QScriptEngine *engine, ScriptCanvas *canvas);
+
+// Times the native bindings against the plain QObject wrapper and prints
+// the cost per call. The canvas has no state, so only the binding is timed.
+int runBindingBenchmark(int calls);
+
+// Evaluates each script run in isolation on one long-lived engine. Construct
+// it after installScriptBindings(): the globals present then are the
+// baseline every run starts from.
+//
+// A run executes in its own pushed context, so `var` and function
+// declarations land in a throwaway activation object. Globals a script
+// creates or overwrites anyway (assignments without `var`) are put back
+// afterwards, and so are the properties of the objects they lead to
+// (canvas, Qt, Math, ...) and of the constructors' prototypes, so nothing
+// leaks into the next run. Objects a script creates itself are not tracked,
+// nor is the QObject behind `canvas`.
+class ScriptRunContext
+{
+public:
+    explicit ScriptRunContext(QScriptEngine *engine);
+
+    // Exceptions stay on the engine, as with QScriptEngine::evaluate().
+    QScriptValue evaluate(const QString &code, const QString &fileName);
+    // Collects what earlier runs left behind; call while nothing runs.
+    void collectGarbage();
+
+private:
+    struct Property
+    {
+        QScriptValue               value;
+        QScriptValue::PropertyFlags flags;
+    };
+
+    // Own properties of one object as every run should find them.
+    struct Snapshot
+    {
+        QScriptValue             object;
+        QHash<QString, Property> properties;
+    };
+
+    void snapshot(const QScriptValue &object);
+    void restoreGlobals();
+
+    QScriptEngine    *m_engine;
+    QVector<Snapshot> m_snapshots;
+};
+
+#endif
@@ -0,0 +1,345 @@
+#include "ScriptEnginePool.h"
+
+#include "CanvasState.h"
+#include "QtScriptBackend.h"
+#include "ScriptCanvas.h"
+#include "ScriptProfiler.h"
+
+#include <QElapsedTimer>
+#include <QLoggingCategory>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QScopedPointer>
+#include <QThread>
+
+Q_LOGGING_CATEGORY(lcEnginePool, "script.pool")
+
+namespace {
+
+// Quiet period after which an idle worker collects its engines' garbage.
+const int kIdleGcDelayMs = 2000;
+
+} // namespace
+
+// Per-thread execution state. Lives entirely on its worker thread.
+class ScriptEnginePool::Worker
+{
+public:
+    Worker(ScriptEnginePool *pool, ScriptEngineKind warmEngine)
+        : m_pool(pool)
+        , m_canvas(&m_state)
+        , m_dirty(false)
+    {
+        // Results are read back once per run; the shared canvas keeps the
+        // history.
+        m_state.setUndoEnabled(false);
+        // Pre-warm: the first script does not pay for engine start-up.
+        engine(warmEngine);
+
+        QObject::connect(&m_canvas, &ScriptCanvas::message, [this](const QString &text) {
+            m_pool->post(m_sender, text);
+        });
+    }
+
+    ScriptRunResult run(const Job &job);
+    void collectGarbage();
+
+private:
+    IScriptEngine *engine(ScriptEngineKind kind);
+
+    ScriptEnginePool *m_pool;
+    CanvasState       m_state;
+    ScriptCanvas      m_canvas;
+    QScopedPointer<IScriptEngine> m_qtScriptEngine;
+    QScopedPointer<IScriptEngine> m_jsEngine;
+    QString           m_sender;
+    bool              m_dirty;
+};
+
+IScriptEngine *ScriptEnginePool::Worker::engine(ScriptEngineKind kind)
+{
+    QScopedPointer<IScriptEngine> &slot = kind == ScriptEngineKind::QJSEngine ? m_jsEngine : m_qtScriptEngine;
+    if (!slot)
+        slot.reset(createScriptEngine(kind, &m_canvas));
+    return slot.data();
+}
+
+ScriptRunResult ScriptEnginePool::Worker::run(const Job &job)
+{
+    // Start from what the shared canvas showed when the script was queued,
+    // so only what the script itself changes is reported back.
+    m_state.reset();
+    m_state.setBackgroundColor(job.background);
+    m_state.setZoomFactor(job.zoom);
+    m_canvas.setImageDirectory(job.imageDirectory);
+    m_sender = job.sender;
+    m_dirty = true;
+
+    const ScriptEngineKind kind = job.profile ? ScriptEngineKind::QtScript
+                                              : scriptEngineForScript(job.code, job.defaultEngine);
+    IScriptEngine *scriptEngine = engine(kind);
+
+    ScriptRunResult result;
+    result.sender = job.sender;
+    result.engine = scriptEngineName(kind);
+
+    // The agent is only attached for this run, so unprofiled runs pay nothing.
+    QScopedPointer<ScriptProfiler> profiler;
+    if (job.profile) {
+        QScriptEngine *qtScript = static_cast<QtScriptBackend *>(scriptEngine)->engine();
+        profiler.reset(new ScriptProfiler(qtScript));
+        qtScript->setAgent(profiler.data());
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    m_canvas.beginRun();
+    m_state.beginBatch();
+    result.ok = scriptEngine->evaluate(job.code, job.fileName);
+    m_canvas.endOpenBatches();
+    m_canvas.endRun();
+    m_state.endBatch();
+    result.evalNs = timer.nsecsElapsed();
+
+    if (profiler) {
+        profiler->finish();
+        profiler->engine()->setAgent(nullptr);
+        result.profileReport = profiler->report();
+        result.profileStacks = profiler->foldedStacks();
+    }
+
+    if (!result.ok) {
+        result.errorLine = scriptEngine->errorLine();
+        result.errorMessage = scriptEngine->errorMessage();
+    }
+    for (int layer = 0; layer < m_state.layerCount(); ++layer)
+        result.layers.append(qMakePair(m_state.layerName(layer), m_state.shapes(layer)));
+    result.removedLayers = m_canvas.removedLayers();
+    result.background = m_state.backgroundColor();
+    result.backgroundSet = result.background != job.background;
+    result.zoom = m_state.zoomFactor();
+    result.zoomSet = !qFuzzyCompare(result.zoom, job.zoom);
+    return result;
+}
+
+void ScriptEnginePool::Worker::collectGarbage()
+{
+    if (!m_dirty)
+        return;
+    m_dirty = false;
+    if (m_qtScriptEngine)
+        m_qtScriptEngine->collectGarbage();
+    if (m_jsEngine)
+        m_jsEngine->collectGarbage();
+}
+
+ScriptEnginePool::ScriptEnginePool(CanvasState *target, QObject *parent)
+    : QObject(parent)
+    , m_target(target)
+    , m_workerCount(0)
+    , m_stopping(false)
+    , m_defaultEngine(ScriptEngineKind::QtScript)
+{
+}
+
+ScriptEnginePool::~ScriptEnginePool()
+{
+    {
+        QMutexLocker locker(&m_lock);
+        m_stopping = true;
+        m_pending.clear();
+        m_turns.clear();
+        m_wake.wakeAll();
+    }
+    for (QThread *thread : m_threads) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+void ScriptEnginePool::setWorkerCount(int count)
+{
+    count = qMax(1, count);
+    QVector<int> relaunch;
+    QVector<QThread *> leaving;
+    {
+        QMutexLocker locker(&m_lock);
+        m_workerCount = count;
+        m_wake.wakeAll();
+
+        // Workers only ever leave on their own; ids below count that are gone
+        // (or on their way out) get a fresh thread, started below.
+        for (int id = 0; id < count; ++id) {
+            if (id < m_threads.size() && m_running.at(id))
+                continue;
+            if (id < m_threads.size()) {
+                leaving.append(m_threads.at(id));
+            } else {
+                m_threads.append(nullptr);
+                m_running.append(false);
+                leaving.append(nullptr);
+            }
+            m_running[id] = true;
+            m_threads[id] = nullptr;
+            relaunch.append(id);
+        }
+    }
+
+    // A leaving worker is past its last script but may still be tearing
+    // down its engines; joining it under the lock would stall submit() and
+    // every other worker meanwhile.
+    for (int i = 0; i < relaunch.size(); ++i) {
+        if (leaving.at(i)) {
+            leaving.at(i)->wait();
+            delete leaving.at(i);
+        }
+        const int id = relaunch.at(i);
+        QThread *thread = QThread::create([this, id]() { runWorker(id); });
+        {
+            QMutexLocker locker(&m_lock);
+            m_threads[id] = thread;
+        }
+        thread->start();
+    }
+    qCInfo(lcEnginePool) << "Engine pool size" << count;
+}
+
+int ScriptEnginePool::workerCount() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_workerCount;
+}
+
+void ScriptEnginePool::setDefaultEngine(ScriptEngineKind kind)
+{
+    QMutexLocker locker(&m_lock);
+    m_defaultEngine = kind;
+}
+
+void ScriptEnginePool::setImageDirectory(const QString &path)
+{
+    QMutexLocker locker(&m_lock);
+    m_imageDirectory = path;
+}
+
+void ScriptEnginePool::submit(const QString &sender, const QString &code, const QString &fileName, bool profile)
+{
+    Job job;
+    job.sender = sender;
+    job.code = code;
+    job.fileName = fileName;
+    job.profile = profile;
+    job.background = m_target->backgroundColor();
+    job.zoom = m_target->zoomFactor();
+
+    QMutexLocker locker(&m_lock);
+    job.defaultEngine = m_defaultEngine;
+    job.imageDirectory = m_imageDirectory;
+    QQueue<Job> &queue = m_pending[sender];
+    queue.enqueue(job);
+    if (queue.size() == 1)
+        m_turns.append(sender);
+    m_wake.wakeOne();
+}
+
+void ScriptEnginePool::runWorker(int id)
+{
+    ScriptEngineKind warmEngine;
+    {
+        QMutexLocker locker(&m_lock);
+        warmEngine = m_defaultEngine;
+    }
+    Worker worker(this, warmEngine);
+
+    Job job;
+    for (;;) {
+        const Take next = take(id, &job);
+        if (next == Take::Stop)
+            return;
+        if (next == Take::Idle) {
+            worker.collectGarbage();
+            continue;
+        }
+
+        const ScriptRunResult result = worker.run(job);
+        finish(job.sender);
+        // Merging touches the shared canvas, so it happens on the pool's thread.
+        QMetaObject::invokeMethod(this, [this, result]() { apply(result); }, Qt::QueuedConnection);
+    }
+}
+
+ScriptEnginePool::Take ScriptEnginePool::take(int id, Job *job)
+{
+    QMutexLocker locker(&m_lock);
+    for (;;) {
+        if (m_stopping || id >= m_workerCount) {
+            m_running[id] = false;
+            return Take::Stop;
+        }
+
+        // The first sender in line that has nothing running goes next and
+        // moves to the back, which makes senders take turns.
+        for (int i = 0; i < m_turns.size(); ++i) {
+            const QString sender = m_turns.at(i);
+            if (m_busy.contains(sender))
+                continue;
+
+            QQueue<Job> &queue = m_pending[sender];
+            *job = queue.dequeue();
+            m_turns.removeAt(i);
+            if (queue.isEmpty())
+                m_pending.remove(sender);
+            else
+                m_turns.append(sender);
+            m_busy.insert(sender);
+            return Take::Run;
+        }
+
+        if (!m_wake.wait(&m_lock, kIdleGcDelayMs))
+            return Take::Idle;
+    }
+}
+
+void ScriptEnginePool::finish(const QString &sender)
+{
+    QMutexLocker locker(&m_lock);
+    m_busy.remove(sender);
+    // The sender's next script may have been skipped while this one ran.
+    if (m_pending.contains(sender))
+        m_wake.wakeOne();
+}
+
+void ScriptEnginePool::post(const QString &sender, const QString &text)
+{
+    QMetaObject::invokeMethod(this, [this, sender, text]() { emit message(sender, text); }, Qt::QueuedConnection);
+}
+
+void ScriptEnginePool::apply(const ScriptRunResult &result)
+{
+    // Removing a layer drops the undo history, so it happens before the
+    // run's own step is recorded.
+    for (const QString &name : result.removedLayers)
+        m_target->removeLayer(name);
+
+    // One undo step per run; only the layers the script selected change,
+    // and within them only the spans that differ from what is shown.
+    m_target->beginBatch(tr("Run Script"));
+    for (const auto &layer : result.layers) {
+        // Each run is capped on its own, but runs of several senders add up.
+        const int index = m_target->selectLayer(layer.first);
+        if (index < 0) {
+            emit message(result.sender, tr("Layer '%1' dropped: the canvas already has %2 layers")
+                                            .arg(layer.first).arg(int(CanvasState::MaxLayers)));
+            continue;
+        }
+        m_target->replaceShapes(index, layer.second);
+    }
+    m_target->selectLayer(QString());
+    if (result.backgroundSet)
+        m_target->setBackgroundColor(result.background);
+    if (result.zoomSet)
+        m_target->setZoomFactor(result.zoom);
+    m_target->endBatch();
+
+    emit scriptFinished(result);
+}
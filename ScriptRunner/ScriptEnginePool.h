@@ -0,0 +1,125 @@
+#ifndef SCRIPTENGINEPOOL_H
+#define SCRIPTENGINEPOOL_H
+
+#include <QColor>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QQueue>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "IScriptEngine.h"
+#include "Shapes.h"
+
+class CanvasState;
+class QThread;
+
+// Everything a finished run produced, to be merged into the shared canvas
+// on the GUI thread.
+struct ScriptRunResult
+{
+    QString sender;
+    QString engine;
+    bool    ok = false;
+    int     errorLine = 0;
+    QString errorMessage;
+    qint64  evalNs = 0;
+    // Every layer the run selected, default layer first.
+    QVector<QPair<QString, ShapeList>> layers;
+    // Layers the run removed with canvas.removeLayer().
+    QStringList removedLayers;
+    bool    backgroundSet = false;
+    QColor  background;
+    bool    zoomSet = false;
+    qreal   zoom = 1.0;
+    // Filled for profiled runs only; see ScriptProfiler.
+    QString profileReport;
+    QString profileStacks;
+};
+
+// Runs scripts on worker threads, each with its own engines and a private
+// CanvasState, so scripts from several editors execute side by side. Results
+// are merged into the target canvas on the pool's thread: every layer a run
+// selected is replaced through CanvasState::replaceShapes(), as one undo
+// step.
+//
+// Scripts of one sender run one at a time and in order; senders with work
+// queued take turns, so a chatty editor cannot starve the others. Workers
+// create the default engine when they start and collect its garbage after
+// a quiet period.
+class ScriptEnginePool : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ScriptEnginePool(CanvasState *target, QObject *parent = nullptr);
+    // Waits for running scripts; queued ones are dropped.
+    ~ScriptEnginePool() override;
+
+    // Surplus workers leave after their current script.
+    void setWorkerCount(int count);
+    int workerCount() const;
+    // Used for scripts without an "// engine:" header.
+    void setDefaultEngine(ScriptEngineKind kind);
+    void setImageDirectory(const QString &path);
+
+    // profile runs the script under ScriptProfiler, on the QtScript engine
+    // whatever it asks for (QJSEngine has no agent interface).
+    void submit(const QString &sender, const QString &code, const QString &fileName, bool profile = false);
+
+signals:
+    // Both are emitted on the pool's thread, scriptFinished() once the
+    // result is on the target canvas.
+    void scriptFinished(const ScriptRunResult &result);
+    void message(const QString &sender, const QString &text);
+
+private:
+    class Worker;
+
+    struct Job
+    {
+        QString          sender;
+        QString          code;
+        QString          fileName;
+        ScriptEngineKind defaultEngine;
+        QString          imageDirectory;
+        // The target canvas as of submit().
+        QColor           background;
+        qreal            zoom;
+        bool             profile;
+    };
+
+    enum class Take
+    {
+        Run,
+        Idle,
+        Stop
+    };
+
+    void runWorker(int id);
+    Take take(int id, Job *job);
+    void finish(const QString &sender);
+    void post(const QString &sender, const QString &text);
+    void apply(const ScriptRunResult &result);
+
+    CanvasState                  *m_target;
+    mutable QMutex                m_lock;
+    QWaitCondition                m_wake;
+    QHash<QString, QQueue<Job>>   m_pending;
+    // Senders with queued scripts, next in line first.
+    QStringList                   m_turns;
+    QSet<QString>                 m_busy;
+    QVector<QThread *>            m_threads;
+    // Cleared by a worker, under the lock, as it decides to leave.
+    QVector<bool>                 m_running;
+    int                           m_workerCount;
+    bool                          m_stopping;
+    ScriptEngineKind              m_defaultEngine;
+    QString                       m_imageDirectory;
+};
+
+#endif
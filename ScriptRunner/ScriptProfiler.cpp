@@ -0,0 +1,308 @@
+#include "ScriptProfiler.h"
+
+#include <QScriptContext>
+#include <QScriptContextInfo>
+#include <QScriptEngine>
+#include <QScriptValueIterator>
+#include <QStringList>
+#include <QTextStream>
+
+#include <algorithm>
+
+namespace {
+
+QString ms(qint64 ns)
+{
+    return QString::number(ns / 1000000.0, 'f', 2);
+}
+
+QString percent(qint64 part, qint64 total)
+{
+    return QString::number(total > 0 ? 100.0 * part / total : 0.0, 'f', 0) + QLatin1Char('%');
+}
+
+} // namespace
+
+ScriptProfiler::ScriptProfiler(QScriptEngine *engine)
+    : QScriptEngineAgent(engine)
+    , m_startNs(0)
+    , m_endNs(-1)
+    , m_line(-1, 0)
+    , m_lineStart(0)
+{
+    // The native drawing calls are plain function objects without a name;
+    // matching the callee against them recovers it.
+    m_canvas = engine->globalObject().property(QStringLiteral("canvas"));
+    QScriptValueIterator it(m_canvas);
+    while (it.hasNext()) {
+        it.next();
+        if (it.value().isFunction())
+            m_canvasNatives.append(qMakePair(it.name(), it.value()));
+    }
+
+    Node root;
+    root.kind = FrameKind::Script;
+    root.parent = -1;
+    root.selfNs = 0;
+    m_nodes.append(root);
+
+    m_clock.start();
+    m_startNs = m_clock.nsecsElapsed();
+}
+
+void ScriptProfiler::finish()
+{
+    const qint64 now = m_clock.nsecsElapsed();
+    chargeLine(now);
+    m_line = qMakePair(qint64(-1), 0);
+    while (!m_stack.isEmpty())
+        closeFrame(now);
+    m_endNs = now;
+}
+
+QString ScriptProfiler::report(int topCount) const
+{
+    const qint64 total = (m_endNs >= 0 ? m_endNs : m_clock.nsecsElapsed()) - m_startNs;
+    qint64 byKind[3] = { 0, 0, 0 };
+    for (const Node &node : m_nodes)
+        byKind[int(node.kind)] += node.selfNs;
+
+    QString text;
+    QTextStream out(&text);
+    out << "Profile: " << ms(total) << " ms; script code " << ms(byKind[int(FrameKind::Script)])
+        << " ms (" << percent(byKind[int(FrameKind::Script)], total) << "), canvas calls "
+        << ms(byKind[int(FrameKind::Canvas)]) << " ms (" << percent(byKind[int(FrameKind::Canvas)], total)
+        << "), other native " << ms(byKind[int(FrameKind::Native)]) << " ms\n";
+
+    QVector<QPair<QString, FunctionStats>> functions;
+    functions.reserve(m_functions.size());
+    for (auto it = m_functions.constBegin(); it != m_functions.constEnd(); ++it)
+        functions.append(qMakePair(it.key(), it.value()));
+    std::sort(functions.begin(), functions.end(),
+              [](const QPair<QString, FunctionStats> &a, const QPair<QString, FunctionStats> &b) {
+                  return a.second.selfNs > b.second.selfNs;
+              });
+
+    out << QStringLiteral("%1 %2 %3  %4\n")
+               .arg(QStringLiteral("self ms"), 10)
+               .arg(QStringLiteral("total ms"), 10)
+               .arg(QStringLiteral("calls"), 9)
+               .arg(QStringLiteral("function"));
+    for (int i = 0; i < functions.size() && i < topCount; ++i) {
+        const FunctionStats &stats = functions.at(i).second;
+        out << QStringLiteral("%1 %2 %3  %4\n")
+                   .arg(ms(stats.selfNs), 10)
+                   .arg(ms(stats.totalNs), 10)
+                   .arg(stats.calls, 9)
+                   .arg(functions.at(i).first);
+    }
+
+    QVector<QPair<QPair<qint64, int>, LineStats>> lines;
+    lines.reserve(m_lines.size());
+    for (auto it = m_lines.constBegin(); it != m_lines.constEnd(); ++it)
+        lines.append(qMakePair(it.key(), it.value()));
+    std::sort(lines.begin(), lines.end(),
+              [](const QPair<QPair<qint64, int>, LineStats> &a, const QPair<QPair<qint64, int>, LineStats> &b) {
+                  return a.second.ns > b.second.ns;
+              });
+
+    out << QStringLiteral("%1 %2  %3\n")
+               .arg(QStringLiteral("ms"), 10)
+               .arg(QStringLiteral("hits"), 9)
+               .arg(QStringLiteral("line"));
+    for (int i = 0; i < lines.size() && i < topCount; ++i) {
+        const QPair<qint64, int> &line = lines.at(i).first;
+        out << QStringLiteral("%1 %2  %3:%4\n")
+                   .arg(ms(lines.at(i).second.ns), 10)
+                   .arg(lines.at(i).second.hits, 9)
+                   .arg(m_scripts.value(line.first, QStringLiteral("(eval)")))
+                   .arg(line.second);
+    }
+    out.flush();
+    return text;
+}
+
+QString ScriptProfiler::foldedStacks() const
+{
+    QString text;
+    QTextStream out(&text);
+    QStringList path;
+    for (int i = 1; i < m_nodes.size(); ++i) {
+        if (m_nodes.at(i).selfNs <= 0)
+            continue;
+
+        path.clear();
+        for (int node = i; node > 0; node = m_nodes.at(node).parent)
+            path.prepend(m_nodes.at(node).name);
+        out << path.join(QLatin1Char(';')) << ' ' << m_nodes.at(i).selfNs << '\n';
+    }
+    out.flush();
+    return text;
+}
+
+void ScriptProfiler::scriptLoad(qint64 id, const QString &program, const QString &fileName, int baseLineNumber)
+{
+    Q_UNUSED(program);
+    Q_UNUSED(baseLineNumber);
+    m_scripts.insert(id, fileName.isEmpty() ? QStringLiteral("(eval)") : fileName);
+}
+
+void ScriptProfiler::functionEntry(qint64 scriptId)
+{
+    QString name;
+    FrameKind kind;
+    frameName(scriptId, &name, &kind);
+
+    const int parent = m_stack.isEmpty() ? 0 : m_stack.last().node;
+    int node = m_nodes.at(parent).children.value(name, -1);
+    if (node < 0) {
+        Node child;
+        child.name = name;
+        child.kind = kind;
+        child.parent = parent;
+        child.selfNs = 0;
+        node = m_nodes.size();
+        m_nodes.append(child);
+        m_nodes[parent].children.insert(name, node);
+    }
+
+    Frame frame;
+    frame.node = node;
+    frame.childNs = 0;
+    frame.line = m_line;
+    m_stack.append(frame);
+    // Read last, so the bookkeeping above is not charged to the callee.
+    m_stack.last().start = m_clock.nsecsElapsed();
+}
+
+void ScriptProfiler::functionExit(qint64 scriptId, const QScriptValue &returnValue)
+{
+    Q_UNUSED(scriptId);
+    Q_UNUSED(returnValue);
+    // Read first, for the same reason as in functionEntry().
+    const qint64 now = m_clock.nsecsElapsed();
+    if (m_stack.isEmpty())
+        return;
+
+    // Back in the caller: until its next position change, time belongs to
+    // the line that made the call, not to the callee's last line.
+    const QPair<qint64, int> line = m_stack.last().line;
+    closeFrame(now);
+    chargeLine(now);
+    m_line = line;
+    m_lineStart = now;
+}
+
+void ScriptProfiler::positionChange(qint64 scriptId, int lineNumber, int columnNumber)
+{
+    Q_UNUSED(columnNumber);
+    const qint64 now = m_clock.nsecsElapsed();
+    chargeLine(now);
+    m_line = qMakePair(scriptId, lineNumber);
+    m_lineStart = now;
+    ++m_lines[m_line].hits;
+}
+
+void ScriptProfiler::frameName(qint64 scriptId, QString *name, FrameKind *kind)
+{
+    // QScriptContextInfo is the expensive part and a function's name never
+    // changes, so it is resolved once per callee. Natives are named after
+    // their this object too, which is part of the key. The program frame
+    // has no callee and is entered once per evaluation anyway.
+    QScriptContext *context = engine()->currentContext();
+    const QScriptValue callee = context ? context->callee() : QScriptValue();
+    if (!callee.isFunction()) {
+        resolveFrameName(scriptId, name, kind);
+        return;
+    }
+
+    const bool onCanvas = scriptId == -1 && context->thisObject().strictlyEquals(m_canvas);
+    const QPair<qint64, bool> key(callee.objectId(), onCanvas);
+    const auto cached = m_frameNames.constFind(key);
+    if (cached != m_frameNames.constEnd()) {
+        *name = cached->name;
+        *kind = cached->kind;
+        return;
+    }
+
+    resolveFrameName(scriptId, name, kind);
+    // Holding the callee keeps its id from being reused by another object.
+    CachedName entry;
+    entry.callee = callee;
+    entry.name = *name;
+    entry.kind = *kind;
+    m_frameNames.insert(key, entry);
+}
+
+void ScriptProfiler::resolveFrameName(qint64 scriptId, QString *name, FrameKind *kind) const
+{
+    QScriptContext *context = engine()->currentContext();
+    const QScriptContextInfo info(context);
+    const QString function = info.functionName();
+
+    if (scriptId != -1) {
+        *kind = FrameKind::Script;
+        // The program itself has no start line; nested functions are told
+        // apart by where they are defined.
+        if (info.functionStartLineNumber() < 0)
+            *name = m_scripts.value(scriptId, QStringLiteral("(program)"));
+        else
+            *name = QStringLiteral("%1:%2")
+                        .arg(function.isEmpty() ? QStringLiteral("(anonymous)") : function)
+                        .arg(info.functionStartLineNumber());
+        return;
+    }
+
+    if (context && context->thisObject().strictlyEquals(m_canvas)) {
+        *kind = FrameKind::Canvas;
+        QString method = function;
+        if (method.isEmpty()) {
+            const QScriptValue callee = context->callee();
+            for (const auto &native : m_canvasNatives) {
+                if (native.second.strictlyEquals(callee)) {
+                    method = native.first;
+                    break;
+                }
+            }
+        }
+        *name = QStringLiteral("canvas.") + (method.isEmpty() ? QStringLiteral("(native)") : method);
+        return;
+    }
+
+    *kind = FrameKind::Native;
+    *name = (function.isEmpty() ? QStringLiteral("(anonymous)") : function) + QStringLiteral(" [native]");
+}
+
+void ScriptProfiler::closeFrame(qint64 now)
+{
+    const Frame frame = m_stack.takeLast();
+    const qint64 total = now - frame.start;
+    const qint64 self = total - frame.childNs;
+
+    Node &node = m_nodes[frame.node];
+    node.selfNs += self;
+
+    // Recursive calls count toward the total once, at the outermost frame.
+    bool recursive = false;
+    for (const Frame &outer : m_stack) {
+        if (m_nodes.at(outer.node).name == node.name) {
+            recursive = true;
+            break;
+        }
+    }
+
+    FunctionStats &stats = m_functions[node.name];
+    ++stats.calls;
+    stats.selfNs += self;
+    if (!recursive)
+        stats.totalNs += total;
+
+    if (!m_stack.isEmpty())
+        m_stack.last().childNs += total;
+}
+
+void ScriptProfiler::chargeLine(qint64 now)
+{
+    if (m_line.second > 0)
+        m_lines[m_line].ns += now - m_lineStart;
+}
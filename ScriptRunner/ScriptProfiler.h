@@ -0,0 +1,109 @@
+#ifndef SCRIPTPROFILER_H
+#define SCRIPTPROFILER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPair>
+#include <QScriptEngineAgent>
+#include <QScriptValue>
+#include <QString>
+#include <QVector>
+
+// Instrumenting profiler for one QtScript run. Install it with
+// QScriptEngine::setAgent() for the runs to profile only: an engine without
+// an agent pays nothing.
+//
+// Records function entry and exit as a call tree (script functions, the
+// canvas bindings and other natives told apart), plus hits and time per
+// source line. Time between two position changes is charged to the earlier
+// line, including native calls made from it; when a call returns, the line
+// that made it is current again.
+class ScriptProfiler : public QScriptEngineAgent
+{
+public:
+    explicit ScriptProfiler(QScriptEngine *engine);
+
+    // Closes frames an exception left open; call once evaluation returned.
+    void finish();
+
+    // Summary for the execution log: the native/script split, then the
+    // hottest functions and lines.
+    QString report(int topCount = 15) const;
+    // "frame;frame;frame ns" per distinct stack, with self time, as read by
+    // flamegraph.pl, speedscope and similar tools.
+    QString foldedStacks() const;
+
+    void scriptLoad(qint64 id, const QString &program, const QString &fileName, int baseLineNumber) override;
+    void functionEntry(qint64 scriptId) override;
+    void functionExit(qint64 scriptId, const QScriptValue &returnValue) override;
+    void positionChange(qint64 scriptId, int lineNumber, int columnNumber) override;
+
+private:
+    enum class FrameKind
+    {
+        Script,
+        Canvas,
+        Native
+    };
+
+    // Call tree node; children are looked up by frame name.
+    struct Node
+    {
+        QString            name;
+        FrameKind          kind;
+        int                parent;
+        qint64             selfNs;
+        QHash<QString, int> children;
+    };
+
+    struct Frame
+    {
+        int    node;
+        qint64 start;
+        qint64 childNs;
+        // The caller's line, current again once the frame closes.
+        QPair<qint64, int> line;
+    };
+
+    struct CachedName
+    {
+        QScriptValue callee;
+        QString      name;
+        FrameKind    kind;
+    };
+
+    struct FunctionStats
+    {
+        int    calls;
+        qint64 selfNs;
+        qint64 totalNs;
+    };
+
+    struct LineStats
+    {
+        int    hits;
+        qint64 ns;
+    };
+
+    void frameName(qint64 scriptId, QString *name, FrameKind *kind);
+    void resolveFrameName(qint64 scriptId, QString *name, FrameKind *kind) const;
+    void closeFrame(qint64 now);
+    void chargeLine(qint64 now);
+
+    QElapsedTimer                     m_clock;
+    qint64                            m_startNs;
+    qint64                            m_endNs;
+    QScriptValue                      m_canvas;
+    QVector<QPair<QString, QScriptValue>> m_canvasNatives;
+    QHash<qint64, QString>            m_scripts;
+    // Keyed by callee object id and whether `this` was the canvas.
+    QHash<QPair<qint64, bool>, CachedName> m_frameNames;
+    QVector<Node>                     m_nodes;
+    QVector<Frame>                    m_stack;
+    QHash<QString, FunctionStats>     m_functions;
+    QHash<QPair<qint64, int>, LineStats> m_lines;
+    QPair<qint64, int>                m_line;
+    qint64                            m_lineStart;
+};
+
+#endif
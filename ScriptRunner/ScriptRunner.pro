@@ -1,4 +1,4 @@
-QT += core gui widgets network script
+QT += core gui widgets network script qml
 
 CONFIG += c++11
 TEMPLATE = app
@@ -18,8 +18,24 @@ CONFIG(debug, debug|release) {
 SOURCES += \
     main.cpp \
     CanvasWidget.cpp \
-    ScriptRunnerWindow.cpp
+    FrameScheduler.cpp \
+    ScriptRunnerWindow.cpp \
+    HeadlessRunner.cpp \
+    ScriptBindings.cpp \
+    IScriptEngine.cpp \
+    QtScriptBackend.cpp \
+    JsEngineBackend.cpp \
+    ScriptEnginePool.cpp \
+    ScriptProfiler.cpp
 
 HEADERS += \
     CanvasWidget.h \
-    ScriptRunnerWindow.h
+    FrameScheduler.h \
+    ScriptRunnerWindow.h \
+    HeadlessRunner.h \
+    ScriptBindings.h \
+    IScriptEngine.h \
+    QtScriptBackend.h \
+    JsEngineBackend.h \
+    ScriptEnginePool.h \
+    ScriptProfiler.h
@@ -1,15 +1,13 @@
 #include "ScriptRunnerWindow.h"
 
 #include "CanvasWidget.h"
-#include "ScriptCanvas.h"
 #include "CanvasState.h"
+#include "ImageCache.h"
 #include "IScriptTransport.h"
 #include "UdpScriptTransport.h"
 #include "ProfileManager.h"
 
 #include <QPlainTextEdit>
-#include <QScriptEngine>
-#include <QScriptValue>
 #include <QLineEdit>
 #include <QSpinBox>
 #include <QLabel>
@@ -27,9 +25,21 @@ Q_LOGGING_CATEGORY(lcRunnerUi, "script.ui.runner")
 #include <QWidget>
 #include <QSplitter>
 #include <QHostAddress>
-#include <QScriptValue>
 #include <QColor>
-#include <QScriptContext>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QRegularExpression>
+#include <QThread>
+
+namespace {
+
+// Lines kept in the execution log; older ones are dropped as new ones
+// arrive, so a long session with chatty scripts stays bounded.
+const int kMaxLogLines = 10000;
+
+} // namespace
 
 ScriptRunnerWindow::ScriptRunnerWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -46,7 +56,9 @@ ScriptRunnerWindow::ScriptRunnerWindow(QWidget *parent)
     , m_canvasState(new CanvasState(this))
     , m_transport(new UdpScriptTransport(this))
     , m_profileManager(new ProfileManager(this))
-    , m_canvasApi(new ScriptCanvas(m_canvasState, this))
+    , m_enginePool(new ScriptEnginePool(m_canvasState, this))
+    , m_engineCountSpin(nullptr)
+    , m_profileAction(nullptr)
 {
     createUi();
 
@@ -55,44 +67,25 @@ ScriptRunnerWindow::ScriptRunnerWindow(QWidget *parent)
             this, &ScriptRunnerWindow::handleScriptReceived);
     connect(m_transport, &IScriptTransport::statusMessage,
             this, &ScriptRunnerWindow::handleClientStatusMessage);
+    connect(m_transport, &IScriptTransport::imageReceived,
+            this, &ScriptRunnerWindow::handleImageReceived);
 
-    QScriptValue canvasObject = m_engine.newQObject(m_canvasApi);
-    m_engine.globalObject().setProperty("canvas", canvasObject);
-
-    // Provide a tiny Qt namespace for scripts so they can reuse color helpers.
-    QScriptValue qtObject = m_engine.newObject();
-    QScriptValue rgbaFunction = m_engine.newFunction([](QScriptContext *context, QScriptEngine *engine) -> QScriptValue {
-        Q_UNUSED(engine);
-        if (context->argumentCount() >= 3) {
-            const qreal r = context->argument(0).toNumber();
-            const qreal g = context->argument(1).toNumber();
-            const qreal b = context->argument(2).toNumber();
-            const qreal a = context->argumentCount() >= 4 ? context->argument(3).toNumber() : 1.0;
-            QColor color;
-            color.setRgbF(qBound(0.0, r, 1.0), qBound(0.0, g, 1.0), qBound(0.0, b, 1.0), qBound(0.0, a, 1.0));
-            return engine->toScriptValue(color);
-        }
-        return engine->undefinedValue();
-    });
-    qtObject.setProperty("rgba", rgbaFunction);
-
-    QScriptValue colorFunction = m_engine.newFunction([](QScriptContext *context, QScriptEngine *engine) -> QScriptValue {
-        if (context->argumentCount() >= 1) {
-            const QString colorStr = context->argument(0).toString();
-            QColor color(colorStr);
-            if (color.isValid()) {
-                return engine->toScriptValue(color);
-            }
-        }
-        return engine->undefinedValue();
-    });
-    qtObject.setProperty("color", colorFunction);
-    m_engine.globalObject().setProperty("Qt", qtObject);
+    // Images not delivered over the transport come from next to the binary.
+    m_enginePool->setImageDirectory(QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("images")));
+    m_enginePool->setWorkerCount(m_engineCountSpin->value());
+    connect(m_enginePool, &ScriptEnginePool::scriptFinished,
+            this, &ScriptRunnerWindow::handleScriptFinished);
 
-    connect(m_canvasApi, &ScriptCanvas::message,
+    connect(m_enginePool, &ScriptEnginePool::message,
             this, &ScriptRunnerWindow::handleScriptPrint);
 }
 
+ScriptRunnerWindow::~ScriptRunnerWindow()
+{
+    // Workers must be gone before the canvas state they report into.
+    delete m_enginePool;
+}
+
 void ScriptRunnerWindow::createUi()
 {
     auto *central = new QWidget(this);
@@ -117,6 +110,7 @@ void ScriptRunnerWindow::createUi()
     rightLayout->addWidget(new QLabel(tr("Execution log:"), rightWidget));
     m_logView = new QPlainTextEdit(rightWidget);
     m_logView->setReadOnly(true);
+    m_logView->setMaximumBlockCount(kMaxLogLines);
     rightLayout->addWidget(m_logView, 1);
 
     splitter->addWidget(m_canvas);
@@ -159,6 +153,14 @@ void ScriptRunnerWindow::createUi()
     m_executeButton = new QPushButton(tr("Execute script"), bottom);
     bottomLayout->addWidget(m_executeButton);
 
+    bottomLayout->addSpacing(12);
+    bottomLayout->addWidget(new QLabel(tr("Engines:"), bottom));
+    m_engineCountSpin = new QSpinBox(bottom);
+    m_engineCountSpin->setRange(1, 64);
+    m_engineCountSpin->setValue(qMax(1, QThread::idealThreadCount()));
+    m_engineCountSpin->setToolTip(tr("Scripts from different senders run in parallel on this many engines."));
+    bottomLayout->addWidget(m_engineCountSpin);
+
     m_udpStatusLabel = new QLabel(tr("UDP: not bound"), bottom);
     bottomLayout->addWidget(m_udpStatusLabel);
 
@@ -169,7 +171,7 @@ void ScriptRunnerWindow::createUi()
     auto *tb = addToolBar(tr("Actions"));
     QAction *clearCanvasAct = tb->addAction(tr("Clear canvas"));
     connect(clearCanvasAct, &QAction::triggered, [this]() {
-        m_canvasApi->clear();
+        m_canvasState->clearAllShapes();
         logMessage(tr("Canvas cleared"));
     });
 
@@ -180,6 +182,11 @@ void ScriptRunnerWindow::createUi()
     addAction(undoCanvasAct);
     addAction(redoCanvasAct);
 
+    tb->addSeparator();
+    m_profileAction = tb->addAction(tr("Profile runs"));
+    m_profileAction->setCheckable(true);
+    m_profileAction->setToolTip(tr("Time functions, canvas calls and lines of the next runs (QtScript only)."));
+
     connect(m_requestButton, &QPushButton::clicked,
             this, &ScriptRunnerWindow::requestScript);
 
@@ -188,6 +195,8 @@ void ScriptRunnerWindow::createUi()
 
     connect(m_localPortSpin, static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged),
             this, &ScriptRunnerWindow::rebindUdp);
+    connect(m_engineCountSpin, static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged),
+            m_enginePool, &ScriptEnginePool::setWorkerCount);
     connect(m_profileCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
             this, &ScriptRunnerWindow::onProfileChanged);
 
@@ -229,7 +238,7 @@ void ScriptRunnerWindow::executeCurrentScript()
         return;
     }
     // Manual execution path so QA can tweak scripts before running them.
-    executeScript(code);
+    executeScript(QStringLiteral("local"), code);
 }
 
 void ScriptRunnerWindow::rebindUdp()
@@ -245,7 +254,18 @@ void ScriptRunnerWindow::handleScriptReceived(const QByteArray &scriptCode, cons
     const QString code = QString::fromUtf8(scriptCode);
     m_scriptView->setPlainText(code);
     // Runner auto-executes so a single click in the editor refreshes the canvas.
-    executeScript(code);
+    executeScript(QStringLiteral("%1:%2").arg(sender.address.toString()).arg(sender.port), code);
+}
+
+void ScriptRunnerWindow::handleImageReceived(const QString &key, const QByteArray &encoded, const TransportEndpoint &sender)
+{
+    // Decoded once and kept across runs; scripts refer to it by key.
+    if (ImageCache::instance().insert(key, encoded)) {
+        logMessage(tr("Image %1 received (%2 bytes)").arg(key).arg(encoded.size()));
+    } else {
+        logMessage(tr("Image %1 from %2 was not stored: undecodable, or too large").arg(key, sender.address.toString()));
+        qCWarning(lcRunnerUi) << "Rejected image" << key << "from" << sender.address << sender.port;
+    }
 }
 
 void ScriptRunnerWindow::handleClientStatusMessage(const QString &message)
@@ -254,25 +274,53 @@ void ScriptRunnerWindow::handleClientStatusMessage(const QString &message)
     logMessage(message);
 }
 
-void ScriptRunnerWindow::executeScript(const QString &code)
+void ScriptRunnerWindow::executeScript(const QString &sender, const QString &code)
 {
-    m_logView->clear();
-    m_canvasApi->clear();
-
     // Each evaluation gets its own virtual file name for better stack traces.
-    QScriptValue result = m_engine.evaluate(code, QStringLiteral("udp-script.qs"));
-    Q_UNUSED(result);
-
-    if (m_engine.hasUncaughtException()) {
-        const int line = m_engine.uncaughtExceptionLineNumber();
-        const QString msg = m_engine.uncaughtException().toString();
-        logMessage(tr("Script error at line %1: %2").arg(line).arg(msg));
-        qCWarning(lcRunnerUi) << "Script error at line" << line << ":" << msg;
+    m_enginePool->submit(sender, code, QStringLiteral("udp-script.qs"), m_profileAction->isChecked());
+    qCInfo(lcRunnerUi) << "Queued script from" << sender;
+}
+
+void ScriptRunnerWindow::handleScriptFinished(const ScriptRunResult &result)
+{
+    const double ms = result.evalNs / 1000000.0;
+    if (!result.ok) {
+        logMessage(tr("[%1] Script error at line %2: %3")
+                       .arg(result.sender).arg(result.errorLine).arg(result.errorMessage));
+        qCWarning(lcRunnerUi) << "Script from" << result.sender << "failed at line" << result.errorLine
+                              << ":" << result.errorMessage;
     } else {
-        logMessage(tr("Script executed successfully."));
-        qCInfo(lcRunnerUi) << "Script executed successfully";
+        logMessage(tr("[%1] Script executed successfully (%2, %3 ms).")
+                       .arg(result.sender, result.engine).arg(ms, 0, 'f', 1));
+    }
+    if (!result.profileReport.isEmpty())
+        writeProfile(result);
+}
+
+void ScriptRunnerWindow::writeProfile(const ScriptRunResult &result)
+{
+    // The table goes to the log as is; the status bar would only show its
+    // first line anyway.
+    m_logView->appendPlainText(result.profileReport);
+
+    QDir dir(QDir(QCoreApplication::applicationDirPath()).filePath(QStringLiteral("profiles")));
+    if (!dir.exists() && !dir.mkpath(QStringLiteral("."))) {
+        logMessage(tr("Cannot create %1").arg(dir.path()));
+        return;
     }
 
+    QString sender = result.sender;
+    sender.replace(QRegularExpression(QStringLiteral("[^A-Za-z0-9_.-]")), QStringLiteral("_"));
+    const QString path = dir.filePath(QStringLiteral("%1-%2.folded")
+                                          .arg(QDateTime::currentDateTime().toString(QStringLiteral("yyyyMMdd-hhmmss-zzz")),
+                                               sender));
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        logMessage(tr("Cannot write profile %1: %2").arg(path, file.errorString()));
+        return;
+    }
+    file.write(result.profileStacks.toUtf8());
+    logMessage(tr("[%1] Flame graph stacks written to %2").arg(result.sender, path));
 }
 
 void ScriptRunnerWindow::logMessage(const QString &msg)
@@ -314,6 +362,10 @@ void ScriptRunnerWindow::applyProfile(const NetworkProfile &profile)
         m_localPortSpin->setValue(profile.runnerPort);
     }
 
+    ScriptEngineKind engine = ScriptEngineKind::QtScript;
+    scriptEngineKindFromName(profile.scriptEngine, &engine);
+    m_enginePool->setDefaultEngine(engine);
+
     // Profiles drive both the remote editor endpoint and our local bind port.
     rebindUdp();
 }
@@ -326,8 +378,8 @@ void ScriptRunnerWindow::onProfileChanged(int index)
     applyProfile(m_profiles.at(index));
 }
 
-void ScriptRunnerWindow::handleScriptPrint(const QString &message)
+void ScriptRunnerWindow::handleScriptPrint(const QString &sender, const QString &message)
 {
     // Mirror console.log behavior to help authors debug scripts.
-    logMessage(tr("Script print: %1").arg(message));
+    logMessage(tr("[%1] Script print: %2").arg(sender, message));
 }
@@ -2,7 +2,6 @@
 #define SCRIPTRUNNERWINDOW_H
 
 #include <QMainWindow>
-#include <QScriptEngine>
 #include <QVector>
 
 class QPlainTextEdit;
@@ -11,15 +10,16 @@ class QSpinBox;
 class QLabel;
 class QPushButton;
 class QComboBox;
+class QAction;
 
 class CanvasWidget;
-class ScriptCanvas;
 class CanvasState;
 class IScriptTransport;
 struct TransportEndpoint;
 class ProfileManager;
 
 #include "../network/ProfileManager.h"
+#include "ScriptEnginePool.h"
 
 // Handles UDP requests plus script execution and canvas presentation.
 class ScriptRunnerWindow : public QMainWindow
@@ -27,19 +27,25 @@ class ScriptRunnerWindow : public QMainWindow
     Q_OBJECT
 public:
     explicit ScriptRunnerWindow(QWidget *parent = nullptr);
+    ~ScriptRunnerWindow() override;
 
 private slots:
     void requestScript();
     void executeCurrentScript();
     void rebindUdp();
-    void handleScriptPrint(const QString &message);
+    void handleScriptPrint(const QString &sender, const QString &message);
+    void handleScriptFinished(const ScriptRunResult &result);
     void handleScriptReceived(const QByteArray &scriptCode, const TransportEndpoint &sender);
+    void handleImageReceived(const QString &key, const QByteArray &encoded, const TransportEndpoint &sender);
     void handleClientStatusMessage(const QString &message);
     void onProfileChanged(int index);
 
 private:
     void createUi();
-    void executeScript(const QString &code);
+    // Queues code on the engine pool; sender identifies the editor for
+    // ordering and fairness.
+    void executeScript(const QString &sender, const QString &code);
+    void writeProfile(const ScriptRunResult &result);
     void logMessage(const QString &msg);
     void loadProfiles();
     void applyProfile(const NetworkProfile &profile);
@@ -62,8 +68,10 @@ private:
     IScriptTransport *m_transport;
     ProfileManager   *m_profileManager;
     QVector<NetworkProfile> m_profiles;
-    ScriptCanvas    *m_canvasApi;
-    QScriptEngine    m_engine;
+    ScriptEnginePool *m_enginePool;
+    QSpinBox         *m_engineCountSpin;
+    // Checked: runs queued from now on are profiled.
+    QAction          *m_profileAction;
 };
 
 #endif
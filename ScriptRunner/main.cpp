@@ -1,9 +1,40 @@
 #include <QApplication>
+#include <QGuiApplication>
+#include <cstring>
 #include "ScriptRunnerWindow.h"
+#include "HeadlessRunner.h"
 #include "../network/IScriptTransport.h"
 
+namespace {
+
+// Checked before any application object exists, because the platform plugin
+// has to be chosen before QGuiApplication is constructed.
+bool hasArgument(int argc, char *argv[], const char *name)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], name) == 0)
+            return true;
+    }
+    return false;
+}
+
+} // namespace
+
 int main(int argc, char *argv[])
 {
+    if (hasArgument(argc, argv, "--headless")) {
+        // Servers have no display; the offscreen platform still provides fonts
+        // and raster painting.
+        if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        QGuiApplication app(argc, argv);
+
+        HeadlessRunner runner;
+        if (!runner.parseArguments(app.arguments()))
+            return 2;
+        return runner.exec();
+    }
+
     QApplication app(argc, argv);
 
     // TransportEndpoint travels across queued signal/slot boundaries.
@@ -0,0 +1,49 @@
+#include "CanvasRenderer.h"
+
+#include "CanvasState.h"
+
+CanvasRenderer::CanvasRenderer(QThreadPool *pool)
+    : m_tiles(pool)
+{
+}
+
+void CanvasRenderer::setLevelOfDetail(const LevelOfDetail &lod)
+{
+    m_tiles.setLevelOfDetail(lod);
+}
+
+LevelOfDetail CanvasRenderer::levelOfDetail() const
+{
+    return m_tiles.levelOfDetail();
+}
+
+void CanvasRenderer::setParallelThreshold(int shapeCount)
+{
+    m_tiles.setParallelThreshold(shapeCount);
+}
+
+QImage CanvasRenderer::render(const CanvasState &state, const QSize &size, qreal devicePixelRatio) const
+{
+    const qreal dpr = devicePixelRatio > 0.0 ? devicePixelRatio : 1.0;
+    QImage image(size * dpr, QImage::Format_ARGB32_Premultiplied);
+    if (image.isNull())
+        return image;
+
+    image.setDevicePixelRatio(dpr);
+    image.fill(state.backgroundColor());
+
+    const qreal zoom = state.zoomFactor() > 0.0 ? state.zoomFactor() : 1.0;
+    const QRectF visibleRect = sceneRect(QRectF(QPointF(0, 0), QSizeF(size)), zoom);
+    // No retained pixels here, so layers simply paint in order.
+    for (int layer = 0; layer < state.layerCount(); ++layer)
+        m_tiles.render(image, state.shapes(layer), state.shapesIn(layer, visibleRect), zoom);
+    return image;
+}
+
+QRectF CanvasRenderer::sceneRect(const QRectF &viewRect, qreal zoom)
+{
+    if (zoom <= 0.0)
+        zoom = 1.0;
+    const QRectF r = viewRect.adjusted(-1, -1, 1, 1);
+    return QRectF(r.x() / zoom, r.y() / zoom, r.width() / zoom, r.height() / zoom);
+}
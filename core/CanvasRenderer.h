@@ -0,0 +1,37 @@
+#ifndef CANVASRENDERER_H
+#define CANVASRENDERER_H
+
+#include <QImage>
+#include <QRectF>
+#include <QSize>
+
+#include "TileRenderer.h"
+
+class CanvasState;
+
+// Renders a complete CanvasState into a standalone image, producing the same
+// pixels CanvasWidget shows for a view of that size. Used wherever a canvas
+// is needed without a window (headless runs, exports).
+class CanvasRenderer
+{
+public:
+    explicit CanvasRenderer(QThreadPool *pool = nullptr);
+
+    void setLevelOfDetail(const LevelOfDetail &lod);
+    LevelOfDetail levelOfDetail() const;
+    // Forwarded to the tile renderer; callers that already run one renderer
+    // per core raise it so tiles do not compete for the same threads.
+    void setParallelThreshold(int shapeCount);
+
+    // size is in logical pixels; the image is size * devicePixelRatio.
+    QImage render(const CanvasState &state, const QSize &size, qreal devicePixelRatio = 1.0) const;
+
+    // Scene area shown by a view rect at zoom, padded by one pixel so
+    // antialiased edges just outside the view are still drawn.
+    static QRectF sceneRect(const QRectF &viewRect, qreal zoom);
+
+private:
+    TileRenderer m_tiles;
+};
+
+#endif
@@ -3,13 +3,36 @@
 #include <QUndoCommand>
 #include <QtGlobal>
 
+namespace {
+
+// Union that keeps zero-area bounds such as points and hairlines.
+void uniteBounds(const ShapeList &shapes, int first, int count, bool *any, QRectF *bounds)
+{
+    for (int i = first; i < first + count; ++i) {
+        const QRectF b = shapes.at(i).boundingRect();
+        if (!*any) {
+            *bounds = b;
+            *any = true;
+            continue;
+        }
+        const qreal left = qMin(bounds->left(), b.left());
+        const qreal top = qMin(bounds->top(), b.top());
+        const qreal right = qMax(bounds->right(), b.right());
+        const qreal bottom = qMax(bounds->bottom(), b.bottom());
+        *bounds = QRectF(QPointF(left, top), QPointF(right, bottom));
+    }
+}
+
+} // namespace
+
 // Each interaction funnels through a tiny undo command so both applications
 // get undo/redo for free via QUndoStack.
 class AddShapeCommand : public QUndoCommand
 {
 public:
-    AddShapeCommand(CanvasState *state, const Shape &shape)
+    AddShapeCommand(CanvasState *state, int layer, const Shape &shape)
         : m_state(state)
+        , m_layer(layer)
         , m_shape(shape)
     {
         setText(QObject::tr("Add Shape"));
@@ -17,29 +40,53 @@ public:
 
     void undo() override
     {
-        ShapeList shapes = m_state->shapes();
-        if (!shapes.isEmpty())
-            shapes.removeLast();
-        m_state->applyShapes(shapes);
+        m_state->removeLastShape(m_layer);
     }
 
     void redo() override
     {
-        ShapeList shapes = m_state->shapes();
-        shapes.append(m_shape);
-        m_state->applyShapes(shapes);
+        m_state->appendShape(m_layer, m_shape);
     }
 
 private:
     CanvasState *m_state;
+    int          m_layer;
     Shape        m_shape;
 };
 
+class AddShapesCommand : public QUndoCommand
+{
+public:
+    AddShapesCommand(CanvasState *state, int layer, const ShapeList &shapes)
+        : m_state(state)
+        , m_layer(layer)
+        , m_shapes(shapes)
+    {
+        setText(QObject::tr("Add Shapes"));
+    }
+
+    void undo() override
+    {
+        m_state->removeLastShapes(m_layer, m_shapes.size());
+    }
+
+    void redo() override
+    {
+        m_state->appendShapes(m_layer, m_shapes);
+    }
+
+private:
+    CanvasState *m_state;
+    int          m_layer;
+    ShapeList    m_shapes;
+};
+
 class ClearShapesCommand : public QUndoCommand
 {
 public:
-    ClearShapesCommand(CanvasState *state, const ShapeList &before)
+    ClearShapesCommand(CanvasState *state, int layer, const ShapeList &before)
         : m_state(state)
+        , m_layer(layer)
         , m_before(before)
     {
         setText(QObject::tr("Clear Canvas"));
@@ -47,17 +94,51 @@ public:
 
     void undo() override
     {
-        m_state->applyShapes(m_before);
+        m_state->applyShapes(m_layer, m_before);
+    }
+
+    void redo() override
+    {
+        m_state->applyShapes(m_layer, ShapeList());
+    }
+
+private:
+    CanvasState *m_state;
+    int          m_layer;
+    ShapeList    m_before;
+};
+
+class ReplaceShapesCommand : public QUndoCommand
+{
+public:
+    // Holds only the differing span, not both complete lists.
+    ReplaceShapesCommand(CanvasState *state, int layer, int first,
+                         const ShapeList &before, const ShapeList &after)
+        : m_state(state)
+        , m_layer(layer)
+        , m_first(first)
+        , m_before(before)
+        , m_after(after)
+    {
+        setText(QObject::tr("Replace Shapes"));
+    }
+
+    void undo() override
+    {
+        m_state->spliceShapes(m_layer, m_first, m_after.size(), m_before);
     }
 
     void redo() override
     {
-        m_state->applyShapes(ShapeList());
+        m_state->spliceShapes(m_layer, m_first, m_before.size(), m_after);
     }
 
 private:
     CanvasState *m_state;
+    int          m_layer;
+    int          m_first;
     ShapeList    m_before;
+    ShapeList    m_after;
 };
 
 class SetBackgroundCommand : public QUndoCommand
@@ -116,15 +197,96 @@ private:
 
 CanvasState::CanvasState(QObject *parent)
     : QObject(parent)
+    , m_layers(1)
+    , m_currentLayer(0)
+    , m_shapesGeneration(0)
     , m_background(Qt::white)
     , m_zoom(1.0)
     , m_undoStack(new QUndoStack(this))
+    , m_undoEnabled(true)
+    , m_batchDepth(0)
+    , m_batchMacroOpen(false)
+    , m_pendingShapes(false)
+    , m_pendingBackground(false)
+    , m_pendingZoom(false)
 {
 }
 
+int CanvasState::layerCount() const
+{
+    return m_layers.size();
+}
+
+QString CanvasState::layerName(int layer) const
+{
+    return m_layers.at(layer).name;
+}
+
+int CanvasState::currentLayer() const
+{
+    return m_currentLayer;
+}
+
+int CanvasState::selectLayer(const QString &name)
+{
+    // Scripts use a handful of layers; a linear scan beats a hash here.
+    for (int i = 0; i < m_layers.size(); ++i) {
+        if (m_layers.at(i).name == name) {
+            m_currentLayer = i;
+            return i;
+        }
+    }
+
+    if (m_layers.size() >= MaxLayers)
+        return -1;
+
+    Layer layer;
+    layer.name = name;
+    layer.generation = ++m_shapesGeneration;
+    m_layers.append(layer);
+    m_currentLayer = m_layers.size() - 1;
+    return m_currentLayer;
+}
+
+bool CanvasState::removeLayer(const QString &name)
+{
+    // Without undo there is no macro a batch could have open.
+    if ((m_batchDepth > 0 && m_undoEnabled) || name.isEmpty())
+        return false;
+
+    for (int i = 1; i < m_layers.size(); ++i) {
+        if (m_layers.at(i).name != name)
+            continue;
+
+        m_undoStack->clear();
+        m_layers.remove(i);
+        if (m_currentLayer == i)
+            m_currentLayer = 0;
+        else if (m_currentLayer > i)
+            --m_currentLayer;
+        emit layerRemoved(i);
+        notifyShapesChanged();
+        return true;
+    }
+    return false;
+}
+
 const ShapeList &CanvasState::shapes() const
 {
-    return m_shapes;
+    return m_layers.at(m_currentLayer).shapes;
+}
+
+const ShapeList &CanvasState::shapes(int layer) const
+{
+    return m_layers.at(layer).shapes;
+}
+
+int CanvasState::shapeCount() const
+{
+    int count = 0;
+    for (const Layer &layer : m_layers)
+        count += layer.shapes.size();
+    return count;
 }
 
 QColor CanvasState::backgroundColor() const
@@ -142,19 +304,120 @@ QUndoStack *CanvasState::undoStack() const
     return m_undoStack;
 }
 
+void CanvasState::setUndoEnabled(bool enabled)
+{
+    m_undoEnabled = enabled;
+}
+
+bool CanvasState::isUndoEnabled() const
+{
+    return m_undoEnabled;
+}
+
+quint64 CanvasState::shapesGeneration(int layer) const
+{
+    return m_layers.at(layer).generation;
+}
+
+QVector<int> CanvasState::shapesIn(int layer, const QRectF &rect) const
+{
+    const Layer &l = m_layers.at(layer);
+    QVector<int> indices = l.index.candidates(rect);
+    // Grid cells are coarse; drop candidates that only share a cell.
+    int kept = 0;
+    for (int i = 0; i < indices.size(); ++i) {
+        const int index = indices.at(i);
+        if (boundsTouch(l.shapes.at(index).boundingRect(), rect))
+            indices[kept++] = index;
+    }
+    indices.resize(kept);
+    return indices;
+}
+
+int CanvasState::shapeAt(const QPointF &point, qreal tolerance, int *layer) const
+{
+    const QRectF probe(point.x() - tolerance, point.y() - tolerance, 2 * tolerance, 2 * tolerance);
+    for (int l = m_layers.size() - 1; l >= 0; --l) {
+        const QVector<int> indices = m_layers.at(l).index.candidates(probe);
+        for (int i = indices.size() - 1; i >= 0; --i) {
+            if (m_layers.at(l).shapes.hitTest(indices.at(i), point, tolerance)) {
+                if (layer)
+                    *layer = l;
+                return indices.at(i);
+            }
+        }
+    }
+    return -1;
+}
+
 void CanvasState::addShape(const Shape &shape)
 {
     // ScriptCanvas always appends, so the command can pop the last element.
-    m_undoStack->push(new AddShapeCommand(this, shape));
+    pushCommand(new AddShapeCommand(this, m_currentLayer, shape));
+}
+
+void CanvasState::addShapes(const ShapeList &shapes)
+{
+    if (shapes.isEmpty())
+        return;
+
+    pushCommand(new AddShapesCommand(this, m_currentLayer, shapes));
 }
 
 void CanvasState::clearShapes()
 {
-    if (m_shapes.isEmpty())
+    const ShapeList &current = shapes();
+    if (current.isEmpty())
         return;
 
     // Carry the previous buffer so undo can restore it in one step.
-    m_undoStack->push(new ClearShapesCommand(this, m_shapes));
+    pushCommand(new ClearShapesCommand(this, m_currentLayer, current));
+}
+
+void CanvasState::clearAllShapes()
+{
+    beginBatch(tr("Clear Canvas"));
+    for (int layer = 0; layer < m_layers.size(); ++layer) {
+        if (!m_layers.at(layer).shapes.isEmpty())
+            pushCommand(new ClearShapesCommand(this, layer, m_layers.at(layer).shapes));
+    }
+    endBatch();
+}
+
+void CanvasState::replaceShapes(int layer, const ShapeList &shapes)
+{
+    // Nothing keeps the old content and no view needs the damaged span, so
+    // copying both sides of the difference would be wasted.
+    if (!m_undoEnabled) {
+        applyShapes(layer, shapes);
+        return;
+    }
+
+    // Comparing records directly is cheaper than hashing runs of them first:
+    // every shape of an unchanged prefix or suffix would be read either way.
+    const ShapeList &current = m_layers.at(layer).shapes;
+    const int oldSize = current.size();
+    const int newSize = shapes.size();
+    int prefix = 0;
+    while (prefix < oldSize && prefix < newSize && current.sameShape(prefix, shapes, prefix))
+        ++prefix;
+    int suffix = 0;
+    while (suffix < oldSize - prefix && suffix < newSize - prefix
+           && current.sameShape(oldSize - 1 - suffix, shapes, newSize - 1 - suffix))
+        ++suffix;
+
+    const int removed = oldSize - prefix - suffix;
+    const int inserted = newSize - prefix - suffix;
+    if (removed == 0 && inserted == 0)
+        return;
+
+    ShapeList before;
+    before.reserve(removed);
+    before.append(current, prefix, removed);
+    ShapeList after;
+    after.reserve(inserted);
+    after.append(shapes, prefix, inserted);
+    pushCommand(new ReplaceShapesCommand(this, layer, prefix, before, after));
 }
 
 void CanvasState::setBackgroundColor(const QColor &color)
@@ -162,7 +425,7 @@ void CanvasState::setBackgroundColor(const QColor &color)
     if (m_background == color)
         return;
 
-    m_undoStack->push(new SetBackgroundCommand(this, m_background, color));
+    pushCommand(new SetBackgroundCommand(this, m_background, color));
 }
 
 void CanvasState::setZoomFactor(qreal zoom)
@@ -170,13 +433,175 @@ void CanvasState::setZoomFactor(qreal zoom)
     if (qFuzzyCompare(m_zoom, zoom))
         return;
 
-    m_undoStack->push(new SetZoomCommand(this, m_zoom, zoom));
+    pushCommand(new SetZoomCommand(this, m_zoom, zoom));
+}
+
+void CanvasState::reset()
+{
+    if (m_batchDepth > 0)
+        return;
+
+    // Commands hold shape buffers and layer indices; dropping them first
+    // releases that memory and lets the extra layers go.
+    m_undoStack->clear();
+    m_layers.resize(1);
+    m_currentLayer = 0;
+    applyShapes(0, ShapeList());
+    applyBackground(Qt::white);
+    applyZoom(1.0);
+}
+
+void CanvasState::beginBatch(const QString &undoText)
+{
+    if (m_batchDepth++ == 0)
+        m_batchText = undoText.isEmpty() ? tr("Batch") : undoText;
+}
+
+void CanvasState::endBatch()
+{
+    if (m_batchDepth == 0)
+        return;
+    if (--m_batchDepth > 0)
+        return;
+
+    if (m_batchMacroOpen) {
+        m_batchMacroOpen = false;
+        m_undoStack->endMacro();
+    }
+
+    // Flush at most one notification per kind, whatever happened inside.
+    if (m_pendingShapes) {
+        m_pendingShapes = false;
+        emit shapesChanged(shapes());
+    }
+    if (m_pendingBackground) {
+        m_pendingBackground = false;
+        emit backgroundChanged(m_background);
+    }
+    if (m_pendingZoom) {
+        m_pendingZoom = false;
+        emit zoomChanged(m_zoom);
+    }
 }
 
-void CanvasState::applyShapes(const ShapeList &shapes)
+bool CanvasState::isBatching() const
 {
-    m_shapes = shapes;
-    emit shapesChanged(m_shapes);
+    return m_batchDepth > 0;
+}
+
+void CanvasState::pushCommand(QUndoCommand *command)
+{
+    if (!m_undoEnabled) {
+        command->redo();
+        delete command;
+        return;
+    }
+
+    // The macro is opened lazily so batches without mutations leave no
+    // empty entries on the undo stack.
+    if (m_batchDepth > 0 && !m_batchMacroOpen) {
+        m_undoStack->beginMacro(m_batchText);
+        m_batchMacroOpen = true;
+    }
+    m_undoStack->push(command);
+}
+
+void CanvasState::applyShapes(int layer, const ShapeList &shapes)
+{
+    Layer &l = m_layers[layer];
+    l.shapes = shapes;
+    l.index.rebuild(l.shapes);
+    l.generation = ++m_shapesGeneration;
+    notifyShapesChanged();
+}
+
+void CanvasState::appendShape(int layer, const Shape &shape)
+{
+    Layer &l = m_layers[layer];
+    l.shapes.append(shape);
+    l.index.insert(l.shapes.size() - 1, shape.boundingRect());
+    notifyShapesChanged();
+}
+
+void CanvasState::appendShapes(int layer, const ShapeList &shapes)
+{
+    Layer &l = m_layers[layer];
+    const int first = l.shapes.size();
+    l.shapes += shapes;
+    for (int i = 0; i < shapes.size(); ++i)
+        l.index.insert(first + i, shapes.at(i).boundingRect());
+    notifyShapesChanged();
+}
+
+void CanvasState::removeLastShape(int layer)
+{
+    Layer &l = m_layers[layer];
+    if (l.shapes.isEmpty())
+        return;
+
+    const int last = l.shapes.size() - 1;
+    l.index.remove(last, l.shapes.at(last).boundingRect());
+    l.shapes.removeLast();
+    l.generation = ++m_shapesGeneration;
+    notifyShapesChanged();
+}
+
+void CanvasState::removeLastShapes(int layer, int count)
+{
+    Layer &l = m_layers[layer];
+    count = qMin(count, l.shapes.size());
+    if (count <= 0)
+        return;
+
+    // Index removal searches from the back, so peel shapes off in reverse.
+    const int first = l.shapes.size() - count;
+    for (int i = l.shapes.size() - 1; i >= first; --i)
+        l.index.remove(i, l.shapes.at(i).boundingRect());
+    l.shapes.truncate(first);
+    l.generation = ++m_shapesGeneration;
+    notifyShapesChanged();
+}
+
+void CanvasState::spliceShapes(int layer, int first, int count, const ShapeList &shapes)
+{
+    Layer &l = m_layers[layer];
+    count = qBound(0, count, l.shapes.size() - first);
+    bool any = false;
+    QRectF damage;
+    uniteBounds(l.shapes, first, count, &any, &damage);
+    uniteBounds(shapes, 0, shapes.size(), &any, &damage);
+
+    if (first + count == l.shapes.size()) {
+        // Tail edits keep the index incremental, peeling off in reverse.
+        for (int i = l.shapes.size() - 1; i >= first; --i)
+            l.index.remove(i, l.shapes.at(i).boundingRect());
+        l.shapes.truncate(first);
+        l.shapes += shapes;
+        for (int i = 0; i < shapes.size(); ++i)
+            l.index.insert(first + i, shapes.at(i).boundingRect());
+    } else {
+        // Indices behind the span shift, so the grid is rebuilt.
+        ShapeList spliced;
+        spliced.reserve(l.shapes.size() - count + shapes.size());
+        spliced.append(l.shapes, 0, first);
+        spliced += shapes;
+        spliced.append(l.shapes, first + count, l.shapes.size() - first - count);
+        l.shapes = spliced;
+        l.index.rebuild(l.shapes);
+    }
+
+    // The generation is kept: views repair the damaged area instead.
+    emit shapesSpliced(layer, first, count, shapes.size(), damage);
+    notifyShapesChanged();
+}
+
+void CanvasState::notifyShapesChanged()
+{
+    if (m_batchDepth > 0) {
+        m_pendingShapes = true;
+        return;
+    }
+    emit shapesChanged(shapes());
 }
 
 void CanvasState::applyBackground(const QColor &color)
@@ -185,6 +610,10 @@ void CanvasState::applyBackground(const QColor &color)
         return;
 
     m_background = color;
+    if (m_batchDepth > 0) {
+        m_pendingBackground = true;
+        return;
+    }
     emit backgroundChanged(m_background);
 }
 
@@ -194,6 +623,10 @@ void CanvasState::applyZoom(qreal zoom)
         return;
 
     m_zoom = zoom;
+    if (m_batchDepth > 0) {
+        m_pendingZoom = true;
+        return;
+    }
     emit zoomChanged(m_zoom);
 }
 
@@ -6,51 +6,153 @@
 #include <QUndoStack>
 
 #include "Shapes.h"
+#include "SpatialIndex.h"
 
 class AddShapeCommand;
+class AddShapesCommand;
 class ClearShapesCommand;
+class ReplaceShapesCommand;
 class SetBackgroundCommand;
 class SetZoomCommand;
 
 // Shared model for everything the runner needs to render: shapes,
 // background and zoom. Views/widgets listen to the signals below.
+//
+// Shapes live in layers painted bottom to top in creation order. Layer 0 is
+// the unnamed default layer; shape mutations apply to the current layer, so
+// replacing one layer leaves the others (and views' pixels for them) alone.
 class CanvasState : public QObject
 {
     Q_OBJECT
 public:
+    // Upper bound on layers, the default one included. A view keeps a full
+    // raster per non-empty layer, so scripts must not create them at will.
+    enum { MaxLayers = 16 };
+
     explicit CanvasState(QObject *parent = nullptr);
 
+    int layerCount() const;
+    QString layerName(int layer) const;
+    int currentLayer() const;
+    // Makes the named layer current, adding an empty one on top if it is
+    // new, and returns its index; -1 (nothing changes) for a new layer once
+    // MaxLayers exist. Not undoable; layers go away with reset() or
+    // removeLayer().
+    int selectLayer(const QString &name);
+    // Drops the named layer and its shapes; the layers above move down one
+    // index. The default layer cannot be removed. Not undoable, and it also
+    // clears the undo history, whose commands refer to layers by index.
+    // Must not be called inside a batch unless undo is off. Returns false if
+    // nothing was removed.
+    bool removeLayer(const QString &name);
+
+    // Shapes of the current layer, or of the given one.
     const ShapeList &shapes() const;
+    const ShapeList &shapes(int layer) const;
+    // Total over all layers.
+    int shapeCount() const;
     QColor backgroundColor() const;
     qreal zoomFactor() const;
     QUndoStack *undoStack() const;
+    // Without undo, mutations apply directly and record nothing, and
+    // replaceShapes() takes the list as is (shared, no diff). For hosts
+    // that only read the result back, e.g. headless runs and pool workers.
+    // On by default; switch it before the first mutation.
+    void setUndoEnabled(bool enabled);
+    bool isUndoEnabled() const;
+    // Bumped whenever existing shapes of the layer are removed or replaced.
+    // Plain appends keep it, so views can draw just the new tail onto cached
+    // pixels. Values are unique across layers and resets.
+    quint64 shapesGeneration(int layer) const;
+
+    // Spatial queries served by incrementally maintained grid indices.
+    // shapesIn() returns indices into shapes(layer) in paint order; shapeAt()
+    // returns the topmost shape under the point across all layers, or -1.
+    QVector<int> shapesIn(int layer, const QRectF &rect) const;
+    int shapeAt(const QPointF &point, qreal tolerance = 0.0, int *layer = nullptr) const;
 
     // All mutations are undoable so the toolbar buttons work automatically.
     void addShape(const Shape &shape);
+    // Appends many shapes as a single undo step and a single notification.
+    void addShapes(const ShapeList &shapes);
     void clearShapes();
+    // Clears every layer as one undo step; the layers themselves stay.
+    void clearAllShapes();
+    // Makes shapes the content of layer as one undo step. Only the span
+    // between the longest common prefix and suffix is actually replaced, so
+    // re-running a slightly edited script touches just what it changed.
+    void replaceShapes(int layer, const ShapeList &shapes);
     void setBackgroundColor(const QColor &color);
     void setZoomFactor(qreal zoom);
+    // Back to an empty white canvas at zoom 1 with only the default layer and
+    // no undo history. Not undoable; meant for hosts that reuse one state
+    // across unrelated runs. Must not be called inside a batch.
+    void reset();
+
+    // Mutations between beginBatch()/endBatch() are applied immediately but
+    // notifications are held back and emitted once when the outermost batch
+    // ends. Commands pushed inside a batch collapse into one undo step.
+    void beginBatch(const QString &undoText = QString());
+    void endBatch();
+    bool isBatching() const;
 
 signals:
     void shapesChanged(const ShapeList &shapes);
+    // removed shapes at first of layer were replaced by inserted others;
+    // damage bounds both in scene coordinates. Emitted right away, even in
+    // a batch, so views can keep their bookkeeping in step. A shapesChanged
+    // notification follows as usual.
+    void shapesSpliced(int layer, int first, int removed, int inserted, const QRectF &damage);
+    // layer is gone and those above it moved down one index. Emitted right
+    // away, before the shapesChanged notification that follows.
+    void layerRemoved(int layer);
     void backgroundChanged(const QColor &color);
     void zoomChanged(qreal zoom);
 
 private:
     // Low level setters used by the undo commands to prevent duplicate stack entries.
-    void applyShapes(const ShapeList &shapes);
+    void applyShapes(int layer, const ShapeList &shapes);
+    void appendShape(int layer, const Shape &shape);
+    void appendShapes(int layer, const ShapeList &shapes);
+    void removeLastShape(int layer);
+    void removeLastShapes(int layer, int count);
+    void spliceShapes(int layer, int first, int count, const ShapeList &shapes);
+    void notifyShapesChanged();
     void applyBackground(const QColor &color);
     void applyZoom(qreal zoom);
+    void pushCommand(QUndoCommand *command);
 
     friend class AddShapeCommand;
+    friend class AddShapesCommand;
     friend class ClearShapesCommand;
+    friend class ReplaceShapesCommand;
     friend class SetBackgroundCommand;
     friend class SetZoomCommand;
 
-    ShapeList  m_shapes;
+    struct Layer
+    {
+        Layer() : generation(0) {}
+
+        QString      name;
+        ShapeList    shapes;
+        SpatialIndex index;
+        quint64      generation;
+    };
+
+    QVector<Layer> m_layers;
+    int          m_currentLayer;
+    quint64      m_shapesGeneration;
     QColor     m_background;
     qreal      m_zoom;
     QUndoStack *m_undoStack;
+    bool       m_undoEnabled;
+
+    int        m_batchDepth;
+    QString    m_batchText;
+    bool       m_batchMacroOpen;
+    bool       m_pendingShapes;
+    bool       m_pendingBackground;
+    bool       m_pendingZoom;
 };
 
 #endif
@@ -0,0 +1,412 @@
+#include "ColorTable.h"
+
+#include <QHash>
+
+#include <cstring>
+
+namespace {
+
+struct NamedColor
+{
+    const char *name;
+    QRgb        rgba;
+};
+
+const int kBucketCount = 64;
+const int kSlotCount = 256;
+// Longest SVG name: "lightgoldenrodyellow".
+const int kMaxNameLength = 20;
+const int kRecentCount = 16;
+
+// Two-level perfect hash over the 147 SVG color keywords plus
+// "transparent", i.e. exactly the names QColor knows. A key's bucket is
+// fnv1a(0, key) % kBucketCount; its slot is fnv1a(seed of that bucket, key)
+// % kSlotCount. Seeds were searched offline so no two keys share a slot.
+const quint16 kBucketSeeds[kBucketCount] = {
+    0, 0, 0, 6, 1, 2, 1, 0, 2, 1, 2, 0,
+    2, 1, 2, 2, 4, 1, 3, 2, 2, 3, 1, 2,
+    4, 2, 1, 0, 2, 1, 1, 3, 3, 0, 1, 0,
+    4, 0, 1, 2, 1, 2, 1, 1, 1, 5, 1, 1,
+    5, 3, 5, 3, 8, 1, 1, 3, 0, 5, 1, 1,
+    1, 5, 1, 14
+};
+
+const NamedColor kNamedColors[kSlotCount] = {
+    { "mediumpurple", 0xff9370db },
+    { "aquamarine", 0xff7fffd4 },
+    { nullptr, 0 },
+    { "darkgrey", 0xffa9a9a9 },
+    { "whitesmoke", 0xfff5f5f5 },
+    { "lightgoldenrodyellow", 0xfffafad2 },
+    { "lightcoral", 0xfff08080 },
+    { nullptr, 0 },
+    { "linen", 0xfffaf0e6 },
+    { "mediumturquoise", 0xff48d1cc },
+    { "goldenrod", 0xffdaa520 },
+    { "coral", 0xffff7f50 },
+    { nullptr, 0 },
+    { "fuchsia", 0xffff00ff },
+    { "thistle", 0xffd8bfd8 },
+    { nullptr, 0 },
+    { "darkseagreen", 0xff8fbc8f },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "lightsteelblue", 0xffb0c4de },
+    { "darkblue", 0xff00008b },
+    { nullptr, 0 },
+    { "darkred", 0xff8b0000 },
+    { nullptr, 0 },
+    { "blueviolet", 0xff8a2be2 },
+    { "purple", 0xff800080 },
+    { nullptr, 0 },
+    { "lightsalmon", 0xffffa07a },
+    { "wheat", 0xfff5deb3 },
+    { "lime", 0xff00ff00 },
+    { "palevioletred", 0xffdb7093 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "lemonchiffon", 0xfffffacd },
+    { "khaki", 0xfff0e68c },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "slategray", 0xff708090 },
+    { "darkturquoise", 0xff00ced1 },
+    { nullptr, 0 },
+    { "greenyellow", 0xffadff2f },
+    { "darksalmon", 0xffe9967a },
+    { "dimgrey", 0xff696969 },
+    { nullptr, 0 },
+    { "chocolate", 0xffd2691e },
+    { nullptr, 0 },
+    { "rosybrown", 0xffbc8f8f },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "firebrick", 0xffb22222 },
+    { "olivedrab", 0xff6b8e23 },
+    { "dodgerblue", 0xff1e90ff },
+    { nullptr, 0 },
+    { "saddlebrown", 0xff8b4513 },
+    { "olive", 0xff808000 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "mediumaquamarine", 0xff66cdaa },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "skyblue", 0xff87ceeb },
+    { "lightskyblue", 0xff87cefa },
+    { "indianred", 0xffcd5c5c },
+    { "palegoldenrod", 0xffeee8aa },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "mediumseagreen", 0xff3cb371 },
+    { "bisque", 0xffffe4c4 },
+    { nullptr, 0 },
+    { "white", 0xffffffff },
+    { nullptr, 0 },
+    { "lavender", 0xffe6e6fa },
+    { nullptr, 0 },
+    { "turquoise", 0xff40e0d0 },
+    { "plum", 0xffdda0dd },
+    { "sandybrown", 0xfff4a460 },
+    { "ghostwhite", 0xfff8f8ff },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "slategrey", 0xff708090 },
+    { "teal", 0xff008080 },
+    { nullptr, 0 },
+    { "lightcyan", 0xffe0ffff },
+    { "grey", 0xff808080 },
+    { "lightyellow", 0xffffffe0 },
+    { nullptr, 0 },
+    { "yellowgreen", 0xff9acd32 },
+    { "violet", 0xffee82ee },
+    { "paleturquoise", 0xffafeeee },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "navy", 0xff000080 },
+    { "springgreen", 0xff00ff7f },
+    { nullptr, 0 },
+    { "gray", 0xff808080 },
+    { "pink", 0xffffc0cb },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "ivory", 0xfffffff0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "mediumblue", 0xff0000cd },
+    { nullptr, 0 },
+    { "cornflowerblue", 0xff6495ed },
+    { "seashell", 0xfffff5ee },
+    { nullptr, 0 },
+    { "moccasin", 0xffffe4b5 },
+    { "blanchedalmond", 0xffffebcd },
+    { "magenta", 0xffff00ff },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "deeppink", 0xffff1493 },
+    { "slateblue", 0xff6a5acd },
+    { "beige", 0xfff5f5dc },
+    { "darkorchid", 0xff9932cc },
+    { "hotpink", 0xffff69b4 },
+    { "gold", 0xffffd700 },
+    { "palegreen", 0xff98fb98 },
+    { nullptr, 0 },
+    { "blue", 0xff0000ff },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "darkolivegreen", 0xff556b2f },
+    { nullptr, 0 },
+    { "lightpink", 0xffffb6c1 },
+    { "darkcyan", 0xff008b8b },
+    { "brown", 0xffa52a2a },
+    { "azure", 0xfff0ffff },
+    { "mistyrose", 0xffffe4e1 },
+    { nullptr, 0 },
+    { "darkslategray", 0xff2f4f4f },
+    { "orangered", 0xffff4500 },
+    { nullptr, 0 },
+    { "darkviolet", 0xff9400d3 },
+    { "gainsboro", 0xffdcdcdc },
+    { nullptr, 0 },
+    { "indigo", 0xff4b0082 },
+    { "darkgreen", 0xff006400 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "black", 0xff000000 },
+    { "crimson", 0xffdc143c },
+    { "peachpuff", 0xffffdab9 },
+    { "royalblue", 0xff4169e1 },
+    { "seagreen", 0xff2e8b57 },
+    { "mediumspringgreen", 0xff00fa9a },
+    { "steelblue", 0xff4682b4 },
+    { "papayawhip", 0xffffefd5 },
+    { "transparent", 0x00000000 },
+    { "cadetblue", 0xff5f9ea0 },
+    { nullptr, 0 },
+    { "cornsilk", 0xfffff8dc },
+    { "mintcream", 0xfff5fffa },
+    { "mediumslateblue", 0xff7b68ee },
+    { "red", 0xffff0000 },
+    { "burlywood", 0xffdeb887 },
+    { "mediumorchid", 0xffba55d3 },
+    { "navajowhite", 0xffffdead },
+    { "darkorange", 0xffff8c00 },
+    { nullptr, 0 },
+    { "midnightblue", 0xff191970 },
+    { nullptr, 0 },
+    { "lavenderblush", 0xfffff0f5 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "lightslategray", 0xff778899 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "orange", 0xffffa500 },
+    { "darkmagenta", 0xff8b008b },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "darkslategrey", 0xff2f4f4f },
+    { "yellow", 0xffffff00 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "antiquewhite", 0xfffaebd7 },
+    { "oldlace", 0xfffdf5e6 },
+    { nullptr, 0 },
+    { "chartreuse", 0xff7fff00 },
+    { "darkslateblue", 0xff483d8b },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "lightslategrey", 0xff778899 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "cyan", 0xff00ffff },
+    { "honeydew", 0xfff0fff0 },
+    { "peru", 0xffcd853f },
+    { "darkkhaki", 0xffbdb76b },
+    { "lightgray", 0xffd3d3d3 },
+    { "salmon", 0xfffa8072 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "mediumvioletred", 0xffc71585 },
+    { "floralwhite", 0xfffffaf0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "lightseagreen", 0xff20b2aa },
+    { "tomato", 0xffff6347 },
+    { nullptr, 0 },
+    { "deepskyblue", 0xff00bfff },
+    { nullptr, 0 },
+    { "powderblue", 0xffb0e0e6 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { nullptr, 0 },
+    { "lawngreen", 0xff7cfc00 },
+    { nullptr, 0 },
+    { "snow", 0xfffffafa },
+    { "tan", 0xffd2b48c },
+    { "aliceblue", 0xfff0f8ff },
+    { "sienna", 0xffa0522d },
+    { "green", 0xff008000 },
+    { nullptr, 0 },
+    { "dimgray", 0xff696969 },
+    { "lightgrey", 0xffd3d3d3 },
+    { "silver", 0xffc0c0c0 },
+    { "lightblue", 0xffadd8e6 },
+    { "forestgreen", 0xff228b22 },
+    { "darkgoldenrod", 0xffb8860b },
+    { "darkgray", 0xffa9a9a9 },
+    { nullptr, 0 },
+    { "limegreen", 0xff32cd32 },
+    { nullptr, 0 },
+    { "lightgreen", 0xff90ee90 },
+    { "maroon", 0xff800000 },
+    { nullptr, 0 },
+    { "aqua", 0xff00ffff },
+    { "orchid", 0xffda70d6 }
+};
+
+quint32 fnv1a(quint32 seed, const char *s, int length)
+{
+    quint32 h = 2166136261u ^ seed;
+    for (int i = 0; i < length; ++i) {
+        h ^= uchar(s[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// QColor ignores blanks and case in color names. Returns -1 for anything
+// that cannot be an SVG name, which then takes the QColor path.
+int normalizedName(const QString &name, char *buffer)
+{
+    int length = 0;
+    for (const QChar ch : name) {
+        const ushort u = ch.unicode();
+        if (u == ' ' || u == '\t')
+            continue;
+        if (u >= 0x80 || length == kMaxNameLength)
+            return -1;
+        buffer[length++] = char(u >= 'A' && u <= 'Z' ? u + ('a' - 'A') : u);
+    }
+    buffer[length] = '\0';
+    return length;
+}
+
+bool findNamed(const char *name, int length, QRgb *rgba)
+{
+    const quint32 bucket = fnv1a(0, name, length) % kBucketCount;
+    const NamedColor &entry = kNamedColors[fnv1a(kBucketSeeds[bucket], name, length) % kSlotCount];
+    if (!entry.name || std::strcmp(entry.name, name) != 0)
+        return false;
+    *rgba = entry.rgba;
+    return true;
+}
+
+// Least-recently-used cache for strings the named table does not cover.
+// Scripts cycle through a handful of hex colors, so a short linear scan
+// beats a hash map and keeps every lookup allocation free.
+class RecentColors
+{
+public:
+    RecentColors()
+        : m_size(0)
+        , m_clock(0)
+    {
+    }
+
+    bool find(const QString &name, uint hash, QColor *color)
+    {
+        for (int i = 0; i < m_size; ++i) {
+            Entry &entry = m_entries[i];
+            if (entry.hash == hash && entry.name == name) {
+                entry.stamp = ++m_clock;
+                *color = entry.color;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void insert(const QString &name, uint hash, const QColor &color)
+    {
+        int slot = m_size;
+        if (m_size < kRecentCount) {
+            ++m_size;
+        } else {
+            slot = 0;
+            for (int i = 1; i < m_size; ++i) {
+                if (m_entries[i].stamp < m_entries[slot].stamp)
+                    slot = i;
+            }
+        }
+
+        Entry &entry = m_entries[slot];
+        entry.name = name;
+        entry.hash = hash;
+        entry.color = color;
+        entry.stamp = ++m_clock;
+    }
+
+private:
+    struct Entry
+    {
+        QString name;
+        uint    hash;
+        QColor  color;
+        quint32 stamp;
+    };
+
+    Entry   m_entries[kRecentCount];
+    int     m_size;
+    quint32 m_clock;
+};
+
+// Per thread, so batch workers never contend on it.
+thread_local RecentColors recentColors;
+
+} // namespace
+
+QColor ColorTable::color(const QString &name)
+{
+    if (!name.startsWith(QLatin1Char('#'))) {
+        char buffer[kMaxNameLength + 1];
+        const int length = normalizedName(name, buffer);
+        QRgb rgba = 0;
+        if (length > 0 && findNamed(buffer, length, &rgba))
+            return QColor::fromRgba(rgba);
+    }
+
+    const uint hash = qHash(name);
+    QColor color;
+    if (recentColors.find(name, hash, &color))
+        return color;
+
+    color = QColor(name);
+    recentColors.insert(name, hash, color);
+    return color;
+}
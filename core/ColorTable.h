@@ -0,0 +1,18 @@
+#ifndef COLORTABLE_H
+#define COLORTABLE_H
+
+#include <QColor>
+#include <QString>
+
+// Interned resolution of script color strings. SVG color names go through a
+// perfect hash table built offline; anything else (hex forms and the like)
+// is parsed by QColor once and then served from a small per-thread cache of
+// recent strings. Results are identical to QColor(name), including invalid
+// colors for names QColor rejects, and lookups never allocate.
+class ColorTable
+{
+public:
+    static QColor color(const QString &name);
+};
+
+#endif
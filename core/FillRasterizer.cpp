@@ -0,0 +1,371 @@
+#include "FillRasterizer.h"
+
+#include <QImage>
+#include <QtMath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define FILLRASTERIZER_SSE2
+#  include <emmintrin.h>
+#endif
+// FILLRASTERIZER_AVX2 comes from the project files, which then also build
+// FillRasterizer_avx2.cpp with AVX2 enabled.
+#if defined(FILLRASTERIZER_AVX2)
+#  include <QtCore/private/qsimd_p.h>
+#endif
+
+namespace {
+
+// Same rounding as Qt's BYTE_MUL so blended interiors match QPainter.
+inline quint32 byteMul(quint32 x, quint32 a)
+{
+    quint32 t = (x & 0xff00ff) * a;
+    t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+    t &= 0xff00ff;
+
+    x = ((x >> 8) & 0xff00ff) * a;
+    x = (x + ((x >> 8) & 0xff00ff) + 0x800080);
+    x &= 0xff00ff00;
+    return x | t;
+}
+
+inline quint32 sourceOver(quint32 dst, quint32 src)
+{
+    return src + byteMul(dst, 255 - qAlpha(src));
+}
+
+inline int toCoverage(qreal coverage)
+{
+    return qBound(0, qRound(coverage * 255), 255);
+}
+
+#if defined(FILLRASTERIZER_SSE2)
+// dst * ia / 255 on four pixels, split into AG and RB 16-bit lanes.
+inline __m128i byteMulSse2(__m128i pixels, __m128i alpha)
+{
+    const __m128i rbMask = _mm_set1_epi32(0x00ff00ff);
+    const __m128i half = _mm_set1_epi16(0x80);
+
+    __m128i ag = _mm_srli_epi16(pixels, 8);
+    __m128i rb = _mm_and_si128(pixels, rbMask);
+    ag = _mm_mullo_epi16(ag, alpha);
+    rb = _mm_mullo_epi16(rb, alpha);
+
+    ag = _mm_add_epi16(_mm_add_epi16(ag, _mm_srli_epi16(ag, 8)), half);
+    rb = _mm_add_epi16(_mm_add_epi16(rb, _mm_srli_epi16(rb, 8)), half);
+    ag = _mm_andnot_si128(rbMask, ag);
+    rb = _mm_srli_epi16(rb, 8);
+    return _mm_or_si128(ag, rb);
+}
+#endif
+
+// Pixel-center interval [first, last] where every edge function of a convex
+// polygon reaches threshold on the scanline. Returns false when empty.
+struct EdgeFunction
+{
+    qreal a;
+    qreal b;
+    qreal c;
+};
+
+bool scanInterval(const EdgeFunction *edges, int count, qreal py, qreal threshold,
+                  qreal *lo, qreal *hi)
+{
+    *lo = -1.0e30;
+    *hi = 1.0e30;
+    for (int i = 0; i < count; ++i) {
+        const qreal k = edges[i].b * py + edges[i].c;
+        if (edges[i].a > 1.0e-12)
+            *lo = qMax(*lo, (threshold - k) / edges[i].a);
+        else if (edges[i].a < -1.0e-12)
+            *hi = qMin(*hi, (threshold - k) / edges[i].a);
+        else if (k < threshold)
+            return false;
+    }
+    return *lo <= *hi;
+}
+
+} // namespace
+
+FillRasterizer::FillRasterizer()
+    : m_bits(nullptr)
+    , m_bytesPerLine(0)
+    , m_scale(1.0)
+    , m_simd(supportedSimd())
+{
+}
+
+FillRasterizer::Simd FillRasterizer::supportedSimd()
+{
+#if defined(FILLRASTERIZER_AVX2)
+    if (qCpuHasFeature(AVX2))
+        return Simd::Avx2;
+#endif
+#if defined(FILLRASTERIZER_SSE2)
+    return Simd::Sse2;
+#else
+    return Simd::None;
+#endif
+}
+
+void FillRasterizer::setSimd(Simd simd)
+{
+    m_simd = qMin(simd, supportedSimd());
+}
+
+FillRasterizer::Simd FillRasterizer::simd() const
+{
+    return m_simd;
+}
+
+bool FillRasterizer::supports(const QImage &image)
+{
+    return image.format() == QImage::Format_ARGB32_Premultiplied
+        || image.format() == QImage::Format_RGB32;
+}
+
+bool FillRasterizer::begin(QImage *image)
+{
+    m_bits = nullptr;
+    if (!image || image->isNull() || !supports(*image))
+        return false;
+
+    m_bits = image->bits();
+    m_bytesPerLine = image->bytesPerLine();
+    m_bounds = image->rect();
+    return m_bits != nullptr;
+}
+
+void FillRasterizer::setTransform(qreal scale, const QPointF &offset)
+{
+    m_scale = scale;
+    m_offset = offset;
+}
+
+void FillRasterizer::fillRect(const QRectF &rect, QRgb color)
+{
+    if (!m_bits || qAlpha(color) == 0)
+        return;
+
+    const QRectF r = QRectF(map(rect.topLeft()), map(rect.bottomRight())).normalized();
+    const qreal x0 = qMax<qreal>(r.left(), m_bounds.left());
+    const qreal y0 = qMax<qreal>(r.top(), m_bounds.top());
+    const qreal x1 = qMin<qreal>(r.right(), m_bounds.right() + 1);
+    const qreal y1 = qMin<qreal>(r.bottom(), m_bounds.bottom() + 1);
+    if (!(x0 < x1) || !(y0 < y1))
+        return;
+
+    const int ix0 = qFloor(x0);
+    const int ix1 = qCeil(x1);
+    const int iy0 = qFloor(y0);
+    const int iy1 = qCeil(y1);
+
+    // Exact area coverage: partial rows and columns only occur at the border.
+    for (int y = iy0; y < iy1; ++y) {
+        const qreal cy = qMin<qreal>(y + 1, y1) - qMax<qreal>(y, y0);
+        quint32 *line = scanLine(y);
+
+        if (ix1 - ix0 == 1) {
+            blendPixel(line + ix0, color, toCoverage((x1 - x0) * cy));
+            continue;
+        }
+
+        blendPixel(line + ix0, color, toCoverage((ix0 + 1 - x0) * cy));
+        const int rowCoverage = toCoverage(cy);
+        if (ix1 - ix0 > 2 && rowCoverage > 0) {
+            const QRgb spanColor = rowCoverage == 255 ? color : byteMul(color, rowCoverage);
+            blendSpan(line + ix0 + 1, ix1 - ix0 - 2, spanColor);
+        }
+        blendPixel(line + ix1 - 1, color, toCoverage((x1 - (ix1 - 1)) * cy));
+    }
+}
+
+void FillRasterizer::fillCircle(const QPointF &center, qreal radius, QRgb color)
+{
+    if (!m_bits || qAlpha(color) == 0)
+        return;
+
+    const QPointF c = map(center);
+    const qreal r = qAbs(radius) * m_scale;
+    if (r <= 0.0)
+        return;
+
+    const qreal outer = r + 0.5;
+    const qreal inner = r - 0.5;
+    const int yStart = qMax(m_bounds.top(), qFloor(c.y() - outer));
+    const int yEnd = qMin(m_bounds.bottom(), qCeil(c.y() + outer));
+    const int xMin = m_bounds.left();
+    const int xMax = m_bounds.right();
+
+    for (int y = yStart; y <= yEnd; ++y) {
+        const qreal dy = y + 0.5 - c.y();
+        if (qAbs(dy) >= outer)
+            continue;
+
+        const qreal wo = qSqrt(outer * outer - dy * dy);
+        const int xs = qMax(xMin, qFloor(c.x() - wo));
+        const int xe = qMin(xMax, qCeil(c.x() + wo));
+        if (xs > xe)
+            continue;
+
+        // Pixels whose center is within r - 0.5 are fully covered.
+        int solidStart = xe + 1;
+        int solidEnd = xe;
+        if (inner > qAbs(dy)) {
+            const qreal wi = qSqrt(inner * inner - dy * dy);
+            solidStart = qMax(xs, qCeil(c.x() - wi - 0.5));
+            solidEnd = qMin(xe, qFloor(c.x() + wi - 0.5));
+            if (solidStart > solidEnd) {
+                solidStart = xe + 1;
+                solidEnd = xe;
+            }
+        }
+
+        quint32 *line = scanLine(y);
+        const qreal dy2 = dy * dy;
+        for (int x = xs; x <= xe; ++x) {
+            if (x == solidStart) {
+                blendSpan(line + x, solidEnd - solidStart + 1, color);
+                x = solidEnd;
+                continue;
+            }
+            const qreal dx = x + 0.5 - c.x();
+            const qreal d = qSqrt(dx * dx + dy2);
+            blendPixel(line + x, color, toCoverage(r - d + 0.5));
+        }
+    }
+}
+
+void FillRasterizer::fillTriangle(const QPointF &a, const QPointF &b, const QPointF &c, QRgb color)
+{
+    if (!m_bits || qAlpha(color) == 0)
+        return;
+
+    const QPointF p[3] = { map(a), map(b), map(c) };
+    const qreal area = (p[1].x() - p[0].x()) * (p[2].y() - p[0].y())
+                     - (p[1].y() - p[0].y()) * (p[2].x() - p[0].x());
+    if (qAbs(area) < 1.0e-9)
+        return;
+    const qreal orientation = area > 0 ? 1.0 : -1.0;
+
+    // Signed distance to each edge, positive inside.
+    EdgeFunction edges[3];
+    for (int i = 0; i < 3; ++i) {
+        const QPointF &from = p[i];
+        const QPointF &to = p[(i + 1) % 3];
+        const qreal ex = to.x() - from.x();
+        const qreal ey = to.y() - from.y();
+        const qreal length = qSqrt(ex * ex + ey * ey);
+        const qreal s = orientation / length;
+        edges[i].a = -ey * s;
+        edges[i].b = ex * s;
+        edges[i].c = (ey * from.x() - ex * from.y()) * s;
+    }
+
+    const qreal left = qMin(p[0].x(), qMin(p[1].x(), p[2].x())) - 0.5;
+    const qreal right = qMax(p[0].x(), qMax(p[1].x(), p[2].x())) + 0.5;
+    const qreal top = qMin(p[0].y(), qMin(p[1].y(), p[2].y())) - 0.5;
+    const qreal bottom = qMax(p[0].y(), qMax(p[1].y(), p[2].y())) + 0.5;
+
+    // The bounding box also trims the antialiasing wedge past sharp vertices.
+    const int xMin = qMax(m_bounds.left(), qFloor(left));
+    const int xMax = qMin(m_bounds.right(), qCeil(right) - 1);
+    const int yStart = qMax(m_bounds.top(), qFloor(top));
+    const int yEnd = qMin(m_bounds.bottom(), qCeil(bottom) - 1);
+
+    for (int y = yStart; y <= yEnd; ++y) {
+        const qreal py = y + 0.5;
+        qreal lo;
+        qreal hi;
+        if (!scanInterval(edges, 3, py, -0.5, &lo, &hi))
+            continue;
+
+        const int xs = qMax(xMin, qCeil(lo - 0.5));
+        const int xe = qMin(xMax, qFloor(hi - 0.5));
+        if (xs > xe)
+            continue;
+
+        int solidStart = xe + 1;
+        int solidEnd = xe;
+        if (scanInterval(edges, 3, py, 0.5, &lo, &hi)) {
+            solidStart = qMax(xs, qCeil(lo - 0.5));
+            solidEnd = qMin(xe, qFloor(hi - 0.5));
+            if (solidStart > solidEnd) {
+                solidStart = xe + 1;
+                solidEnd = xe;
+            }
+        }
+
+        quint32 *line = scanLine(y);
+        for (int x = xs; x <= xe; ++x) {
+            if (x == solidStart) {
+                blendSpan(line + x, solidEnd - solidStart + 1, color);
+                x = solidEnd;
+                continue;
+            }
+            const qreal px = x + 0.5;
+            qreal d = edges[0].a * px + edges[0].b * py + edges[0].c;
+            d = qMin(d, edges[1].a * px + edges[1].b * py + edges[1].c);
+            d = qMin(d, edges[2].a * px + edges[2].b * py + edges[2].c);
+            blendPixel(line + x, color, toCoverage(d + 0.5));
+        }
+    }
+}
+
+quint32 *FillRasterizer::scanLine(int y) const
+{
+    return reinterpret_cast<quint32 *>(m_bits + y * m_bytesPerLine);
+}
+
+void FillRasterizer::blendSpan(quint32 *dst, int count, QRgb color) const
+{
+    if (count <= 0)
+        return;
+
+    int i = 0;
+#if defined(FILLRASTERIZER_AVX2)
+    // The wide kernel leaves the last few pixels to the paths below.
+    if (m_simd >= Simd::Avx2)
+        i = blendSpanAvx2(dst, count, color);
+#endif
+    if (qAlpha(color) == 255) {
+#if defined(FILLRASTERIZER_SSE2)
+        if (m_simd >= Simd::Sse2) {
+            const __m128i solid4 = _mm_set1_epi32(int(color));
+            for (; i + 4 <= count; i += 4)
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), solid4);
+        }
+#endif
+        for (; i < count; ++i)
+            dst[i] = color;
+        return;
+    }
+
+    const quint32 inverseAlpha = 255 - qAlpha(color);
+#if defined(FILLRASTERIZER_SSE2)
+    if (m_simd >= Simd::Sse2) {
+        const __m128i src4 = _mm_set1_epi32(int(color));
+        const __m128i ia4 = _mm_set1_epi16(short(inverseAlpha));
+        for (; i + 4 <= count; i += 4) {
+            __m128i *p = reinterpret_cast<__m128i *>(dst + i);
+            const __m128i d = _mm_loadu_si128(p);
+            _mm_storeu_si128(p, _mm_add_epi8(src4, byteMulSse2(d, ia4)));
+        }
+    }
+#endif
+    for (; i < count; ++i)
+        dst[i] = color + byteMul(dst[i], inverseAlpha);
+}
+
+void FillRasterizer::blendPixel(quint32 *dst, QRgb color, int coverage) const
+{
+    if (coverage <= 0)
+        return;
+
+    const quint32 src = coverage >= 255 ? color : byteMul(color, coverage);
+    *dst = sourceOver(*dst, src);
+}
+
+QPointF FillRasterizer::map(const QPointF &p) const
+{
+    return QPointF(p.x() * m_scale + m_offset.x(), p.y() * m_scale + m_offset.y());
+}
@@ -0,0 +1,70 @@
+#ifndef FILLRASTERIZER_H
+#define FILLRASTERIZER_H
+
+#include <QPointF>
+#include <QRect>
+#include <QRectF>
+#include <QRgb>
+
+class QImage;
+
+// Software span filler for the primitives that dominate our scenes: axis
+// aligned rects, filled circles and triangles. It writes antialiased,
+// source-over blended spans straight into 32-bit premultiplied pixels, with
+// SSE2 for the solid interiors, or AVX2 on CPUs that have it (checked at run
+// time; the AVX2 kernel lives in FillRasterizer_avx2.cpp).
+//
+// Coverage is area based for rects and distance based for circle and
+// triangle edges. Interiors match QPainter exactly; edges differ by at most a
+// few percent of coverage, most on diagonal edges (`ScriptRunner --headless
+// --compare-fills` checks the bound). Only scale + translate transforms are
+// supported; callers keep QPainter for everything else.
+class FillRasterizer
+{
+public:
+    // Vector paths used for span fills, narrowest first.
+    enum class Simd
+    {
+        None,
+        Sse2,
+        Avx2
+    };
+
+    FillRasterizer();
+
+    // The widest path both this build and the CPU support; the default.
+    static Simd supportedSimd();
+    // Restricts span fills to at most simd, e.g. to check the paths against
+    // each other. Values above supportedSimd() are clamped.
+    void setSimd(Simd simd);
+    Simd simd() const;
+
+    // Accepts Format_ARGB32_Premultiplied and Format_RGB32 images.
+    static bool supports(const QImage &image);
+
+    bool begin(QImage *image);
+    // Maps scene to device pixels as device = scene * scale + offset.
+    void setTransform(qreal scale, const QPointF &offset);
+
+    // Colors are premultiplied ARGB, as stored in Shape.
+    void fillRect(const QRectF &rect, QRgb color);
+    void fillCircle(const QPointF &center, qreal radius, QRgb color);
+    void fillTriangle(const QPointF &a, const QPointF &b, const QPointF &c, QRgb color);
+
+private:
+    quint32 *scanLine(int y) const;
+    void blendSpan(quint32 *dst, int count, QRgb color) const;
+    // Blends the leading multiple of eight pixels and returns how many.
+    static int blendSpanAvx2(quint32 *dst, int count, QRgb color);
+    void blendPixel(quint32 *dst, QRgb color, int coverage) const;
+    QPointF map(const QPointF &p) const;
+
+    uchar  *m_bits;
+    int     m_bytesPerLine;
+    QRect   m_bounds;
+    qreal   m_scale;
+    QPointF m_offset;
+    Simd    m_simd;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#include "FillRasterizer.h"
+
+// Built with AVX2 enabled (-mavx2, /arch:AVX2) while the rest of the library
+// keeps the baseline instruction set, so nothing here may run before
+// FillRasterizer has checked the CPU.
+#include <immintrin.h>
+
+namespace {
+
+// dst * ia / 255 on eight pixels; same rounding as the SSE2 and scalar paths.
+inline __m256i byteMulAvx2(__m256i pixels, __m256i alpha)
+{
+    const __m256i rbMask = _mm256_set1_epi32(0x00ff00ff);
+    const __m256i half = _mm256_set1_epi16(0x80);
+
+    __m256i ag = _mm256_srli_epi16(pixels, 8);
+    __m256i rb = _mm256_and_si256(pixels, rbMask);
+    ag = _mm256_mullo_epi16(ag, alpha);
+    rb = _mm256_mullo_epi16(rb, alpha);
+
+    ag = _mm256_add_epi16(_mm256_add_epi16(ag, _mm256_srli_epi16(ag, 8)), half);
+    rb = _mm256_add_epi16(_mm256_add_epi16(rb, _mm256_srli_epi16(rb, 8)), half);
+    ag = _mm256_andnot_si256(rbMask, ag);
+    rb = _mm256_srli_epi16(rb, 8);
+    return _mm256_or_si256(ag, rb);
+}
+
+} // namespace
+
+int FillRasterizer::blendSpanAvx2(quint32 *dst, int count, QRgb color)
+{
+    int i = 0;
+    const __m256i src8 = _mm256_set1_epi32(int(color));
+    if (qAlpha(color) == 255) {
+        for (; i + 8 <= count; i += 8)
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), src8);
+        return i;
+    }
+
+    const __m256i ia8 = _mm256_set1_epi16(short(255 - qAlpha(color)));
+    for (; i + 8 <= count; i += 8) {
+        __m256i *p = reinterpret_cast<__m256i *>(dst + i);
+        const __m256i d = _mm256_loadu_si256(p);
+        _mm256_storeu_si256(p, _mm256_add_epi8(src8, byteMulAvx2(d, ia8)));
+    }
+    return i;
+}
@@ -0,0 +1,148 @@
+#include "ImageCache.h"
+
+#include <QBuffer>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QMutexLocker>
+#include <QStringList>
+
+namespace {
+
+// QCache costs are ints, so budgets are tracked in KiB.
+const qint64 CostUnit = 1024;
+const qint64 DefaultBudget = 64 * 1024 * 1024;
+// 64 MiB premultiplied; decoding anything larger only serves a memory bomb.
+const qint64 MaxPixels = 4096 * 4096;
+// Remembered failed lookups before the list starts over.
+const int MaxMisses = 4096;
+
+QImage prepared(const QImage &image)
+{
+    return image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+
+int costOf(const QImage &image)
+{
+    return int((image.sizeInBytes() + CostUnit - 1) / CostUnit);
+}
+
+// Reads the header first so oversized images are refused before any pixel
+// memory is allocated.
+QImage decodeBounded(QImageReader *reader, qint64 maxPixels)
+{
+    const QSize size = reader->size();
+    if (!size.isValid() || qint64(size.width()) * size.height() > maxPixels)
+        return QImage();
+    return reader->read();
+}
+
+} // namespace
+
+ImageCache &ImageCache::instance()
+{
+    static ImageCache cache;
+    return cache;
+}
+
+ImageCache::ImageCache()
+    : m_images(int(DefaultBudget / CostUnit))
+{
+}
+
+void ImageCache::setByteBudget(qint64 bytes)
+{
+    QMutexLocker lock(&m_mutex);
+    m_images.setMaxCost(int(qMax<qint64>(0, bytes) / CostUnit));
+}
+
+qint64 ImageCache::byteBudget() const
+{
+    QMutexLocker lock(&m_mutex);
+    return qint64(m_images.maxCost()) * CostUnit;
+}
+
+qint64 ImageCache::maxPixels() const
+{
+    return qMin(MaxPixels, byteBudget() / 4);
+}
+
+bool ImageCache::insert(const QString &key, const QByteArray &encoded)
+{
+    // Decode outside the lock; renders may be looking images up meanwhile.
+    QBuffer buffer;
+    buffer.setData(encoded);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+    const QImage image = decodeBounded(&reader, maxPixels());
+    if (image.isNull())
+        return false;
+    return insert(key, image);
+}
+
+bool ImageCache::insert(const QString &key, const QImage &image)
+{
+    if (image.isNull())
+        return false;
+    QImage *entry = new QImage(prepared(image));
+    const int cost = costOf(*entry);
+    QMutexLocker lock(&m_mutex);
+    m_missing.remove(key);
+    // Images larger than the whole budget are rejected (and deleted) here.
+    return m_images.insert(key, entry, cost);
+}
+
+QImage ImageCache::image(const QString &key) const
+{
+    QMutexLocker lock(&m_mutex);
+    // Copies are shallow; eviction never invalidates an image in use.
+    const QImage *entry = m_images.object(key);
+    return entry ? *entry : QImage();
+}
+
+QImage ImageCache::load(const QString &directory, const QString &name)
+{
+    // Names come from scripts: only plain relative paths below directory.
+    const QString relative = QString(name).replace(QLatin1Char('\\'), QLatin1Char('/'));
+    if (relative.isEmpty() || QDir::isAbsolutePath(relative) || relative.startsWith(QLatin1Char('/'))
+        || relative.contains(QLatin1Char(':'))
+        || relative.split(QLatin1Char('/')).contains(QStringLiteral("..")))
+        return QImage();
+
+    const QString key = QDir::cleanPath(QDir(directory).absoluteFilePath(relative));
+    {
+        QMutexLocker lock(&m_mutex);
+        if (const QImage *entry = m_images.object(key))
+            return *entry;
+        if (m_missing.contains(key))
+            return QImage();
+    }
+
+    // Links may still lead elsewhere, so the real location is checked too.
+    // Two threads may decode the same file once each; the later insert wins.
+    const QString root = QFileInfo(directory).canonicalFilePath();
+    const QString file = QFileInfo(key).canonicalFilePath();
+    QImage decoded;
+    if (!root.isEmpty() && file.startsWith(root + QLatin1Char('/'))) {
+        QImageReader reader(file);
+        decoded = decodeBounded(&reader, maxPixels());
+    }
+    if (decoded.isNull()) {
+        QMutexLocker lock(&m_mutex);
+        if (m_missing.size() >= MaxMisses)
+            m_missing.clear();
+        m_missing.insert(key);
+        return QImage();
+    }
+
+    const QImage result = prepared(decoded);
+    insert(key, result);
+    return result;
+}
+
+void ImageCache::clear()
+{
+    QMutexLocker lock(&m_mutex);
+    m_images.clear();
+    m_missing.clear();
+}
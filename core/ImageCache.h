@@ -0,0 +1,55 @@
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+// Decoded images shared by every canvas in the process, so icons delivered
+// over the transport or read from disk are decoded once and survive across
+// script runs. Images are stored premultiplied, which is what the raster
+// engine blends without converting. The least recently used entries are
+// dropped once the byte budget is exceeded. Thread-safe.
+//
+// Keys and payloads come from scripts and the network, so nothing is
+// decoded whose header announces more than maxPixels(), and files are only
+// read from inside the directory a canvas was given.
+class ImageCache
+{
+public:
+    static ImageCache &instance();
+
+    void setByteBudget(qint64 bytes);
+    qint64 byteBudget() const;
+
+    // Largest image accepted for decoding: a fixed cap, lowered to what the
+    // byte budget can hold.
+    qint64 maxPixels() const;
+
+    // Decodes data in any format QImageReader knows and stores it under key,
+    // replacing an older entry. Returns false if nothing was stored: the
+    // header is unreadable or too large, or the data does not decode.
+    bool insert(const QString &key, const QByteArray &encoded);
+    // Returns false if the image alone exceeds the budget and was dropped.
+    bool insert(const QString &key, const QImage &image);
+    // A null image when nothing is cached under key.
+    QImage image(const QString &key) const;
+    // The file name inside directory, decoded on first use and cached by its
+    // absolute path afterwards. Names that are absolute or contain ".." are
+    // refused, as are files that resolve (e.g. through a link) outside
+    // directory. Failed lookups are remembered until clear().
+    QImage load(const QString &directory, const QString &name);
+    void clear();
+
+private:
+    ImageCache();
+
+    mutable QMutex          m_mutex;
+    QCache<QString, QImage> m_images;
+    QSet<QString>           m_missing;
+};
+
+#endif
@@ -0,0 +1,731 @@
+#include "SceneRenderer.h"
+
+#include <QPainter>
+#include <QStaticText>
+#include <QtMath>
+
+#include <cstring>
+
+namespace {
+
+// Sprites wider or taller than this are cheaper to draw directly, and the
+// cache is dropped once its masks and tints take this many bytes.
+const int MaxSpriteExtent = 128;
+const qint64 MaxSpriteBytes = 16 * 1024 * 1024;
+// Prepared text layouts kept per thread before the cache starts over.
+const int MaxPreparedTexts = 2048;
+
+// Run key: fields that do not affect how a primitive is painted are zeroed
+// so e.g. filled circles with different (unused) pen widths still batch.
+void normalizedStyle(const Shape &s, QRgb *fill, QRgb *stroke, float *penWidth)
+{
+    *fill = s.fill;
+    *stroke = s.stroke;
+    *penWidth = s.penWidth;
+    switch (s.type) {
+    case ShapeType::FilledCircle:
+        *stroke = 0;
+        *penWidth = 0.0f;
+        break;
+    case ShapeType::StrokeCircle:
+    case ShapeType::Line:
+    case ShapeType::Polyline:
+        *fill = 0;
+        break;
+    case ShapeType::Rect:
+    case ShapeType::Triangle:
+    case ShapeType::Polygon:
+        if (!s.hasStroke())
+            *penWidth = 0.0f;
+        break;
+    case ShapeType::Instances:
+        break;
+    case ShapeType::Text:
+        *stroke = 0;
+        *penWidth = 0.0f;
+        break;
+    case ShapeType::Image:
+        break;
+    }
+}
+
+// QStaticText lays out against the linear part of the device transform, so
+// that and the font identify a layout; translation is free.
+struct TextKey
+{
+    QString text;
+    QString font;
+    qreal   m11, m12, m21, m22;
+
+    bool operator==(const TextKey &other) const
+    {
+        return text == other.text && font == other.font && m11 == other.m11
+            && m12 == other.m12 && m21 == other.m21 && m22 == other.m22;
+    }
+};
+
+uint qHash(const TextKey &key, uint seed)
+{
+    seed = qHash(key.text, seed);
+    seed = qHash(key.font, seed);
+    seed = qHash(key.m11, seed) ^ qHash(key.m22, seed);
+    return seed ^ qHash(key.m12, seed) ^ qHash(key.m21, seed);
+}
+
+// Labels repeat across frames and tiles, so layouts outlive renderers. The
+// cache is per thread because QStaticText is not safe to paint from several
+// threads at once.
+const QStaticText &preparedText(const QString &text, const QFont &font, const QTransform &t)
+{
+    static thread_local QHash<TextKey, QStaticText> cache;
+
+    TextKey key;
+    key.text = text;
+    key.font = font.key();
+    key.m11 = t.m11();
+    key.m12 = t.m12();
+    key.m21 = t.m21();
+    key.m22 = t.m22();
+    auto it = cache.constFind(key);
+    if (it != cache.constEnd())
+        return *it;
+
+    if (cache.size() >= MaxPreparedTexts)
+        cache.clear();
+    QStaticText label(text);
+    label.setTextFormat(Qt::PlainText);
+    label.setPerformanceHint(QStaticText::AggressiveCaching);
+    label.prepare(QTransform(t.m11(), t.m12(), t.m21(), t.m22(), 0.0, 0.0), font);
+    return *cache.insert(key, label);
+}
+
+void drawLabel(QPainter &painter, const ShapeList &shapes, const Shape &s)
+{
+    const QFont &font = shapes.font(s);
+    const QStaticText &label = preparedText(shapes.text(s), font, painter.deviceTransform());
+    painter.setFont(font);
+    painter.setPen(s.fillColor());
+    painter.drawStaticText(shapes.textPosition(s), label);
+}
+
+// Splits a device coordinate into whole pixels and a quarter-pixel step.
+void snapQuarter(qreal v, int *whole, quint8 *quarter)
+{
+    const int q = qFloor(v * 4.0 + 0.5);
+    *whole = q >> 2;
+    *quarter = quint8(q & 3);
+}
+
+// Snaps a device scale so a sprite whose template spans unitExtent moves in
+// quarter-pixel steps; continuously varying sizes then share a bounded set
+// of masks.
+float snapScale(qreal scale, qreal unitExtent)
+{
+    const qreal step = 0.25 / qMax<qreal>(unitExtent, 1.0);
+    return float(qMax<qint64>(1, qRound64(scale / step)) * step);
+}
+
+// Same rounding as Qt's BYTE_MUL.
+inline QRgb byteMul(QRgb x, uint a)
+{
+    quint32 t = (x & 0xff00ff) * a;
+    t = (t + ((t >> 8) & 0xff00ff) + 0x800080) >> 8;
+    t &= 0xff00ff;
+
+    x = ((x >> 8) & 0xff00ff) * a;
+    x = (x + ((x >> 8) & 0xff00ff) + 0x800080);
+    x &= 0xff00ff00;
+    return x | t;
+}
+
+} // namespace
+
+bool operator==(const SceneRenderer::SpriteKey &a, const SceneRenderer::SpriteKey &b)
+{
+    return std::memcmp(&a, &b, sizeof(SceneRenderer::SpriteKey)) == 0;
+}
+
+uint qHash(const SceneRenderer::SpriteKey &key, uint seed)
+{
+    return qHashBits(&key, sizeof(key), seed);
+}
+
+SceneRenderer::SceneRenderer()
+    : m_spriteBytes(0)
+    , m_softwareFills(true)
+    , m_stateValid(false)
+    , m_currentFill(0)
+    , m_currentStroke(0)
+    , m_currentPenWidth(0.0f)
+{
+}
+
+void SceneRenderer::setLevelOfDetail(const LevelOfDetail &lod)
+{
+    m_lod = lod;
+}
+
+LevelOfDetail SceneRenderer::levelOfDetail() const
+{
+    return m_lod;
+}
+
+void SceneRenderer::setSoftwareFills(bool enabled)
+{
+    m_softwareFills = enabled;
+}
+
+bool SceneRenderer::softwareFills() const
+{
+    return m_softwareFills;
+}
+
+void SceneRenderer::draw(QPainter &painter, const ShapeList &shapes)
+{
+    compile(shapes, nullptr, shapes.size(), viewScale(painter));
+    execute(painter, shapes);
+}
+
+void SceneRenderer::draw(QPainter &painter, const ShapeList &shapes, const QVector<int> &indices)
+{
+    compile(shapes, indices.constData(), indices.size(), viewScale(painter));
+    execute(painter, shapes);
+}
+
+void SceneRenderer::compile(const ShapeList &shapes, const int *indices, int count, qreal scale)
+{
+    // Only neighbours are merged, so z-order is preserved exactly.
+    m_runs.clear();
+    m_order.clear();
+    m_order.reserve(count);
+
+    const bool lod = m_lod.enabled;
+    const bool aliasHairlines = lod && scale < m_lod.aliasedHairlineScale;
+
+    for (int i = 0; i < count; ++i) {
+        const int index = indices ? indices[i] : i;
+        const Shape &s = shapes.at(index);
+
+        Run key;
+        key.type = s.type;
+        key.asPoints = false;
+        key.aliased = false;
+        normalizedStyle(s, &key.fill, &key.stroke, &key.penWidth);
+
+        if (lod) {
+            const QRectF bounds = s.boundingRect();
+            const qreal extent = qMax(bounds.width(), bounds.height()) * scale;
+            if (extent < m_lod.cullExtent)
+                continue;
+            if (extent < m_lod.pointExtent) {
+                // Sub-pixel shapes collapse to one cosmetic point in their
+                // dominant color.
+                key.asPoints = true;
+                key.stroke = s.hasFill() ? s.fill : s.stroke;
+                key.fill = 0;
+                key.penWidth = 0.0f;
+            } else if (aliasHairlines && key.stroke != 0 && !s.hasFill()
+                       && key.penWidth * scale <= 1.0) {
+                key.aliased = true;
+            }
+        }
+
+        if (!m_runs.isEmpty()) {
+            Run &last = m_runs.last();
+            if (last.asPoints == key.asPoints && (key.asPoints || last.type == key.type)
+                && last.aliased == key.aliased && last.fill == key.fill
+                && last.stroke == key.stroke && last.penWidth == key.penWidth) {
+                ++last.count;
+                m_order.append(index);
+                continue;
+            }
+        }
+
+        key.first = m_order.size();
+        key.count = 1;
+        m_runs.append(key);
+        m_order.append(index);
+    }
+}
+
+void SceneRenderer::execute(QPainter &painter, const ShapeList &shapes)
+{
+    const bool antialiased = painter.testRenderHint(QPainter::Antialiasing);
+    const bool software = beginSoftwareFills(painter);
+    bool aliased = false;
+    m_stateValid = false;
+
+    for (const Run &run : m_runs) {
+        applyState(painter, run);
+        if (antialiased && run.aliased != aliased) {
+            aliased = run.aliased;
+            painter.setRenderHint(QPainter::Antialiasing, !aliased);
+        }
+
+        if (software && !run.asPoints && qAlpha(run.fill) != 0 && fillRun(painter, run, shapes))
+            continue;
+
+        const int end = run.first + run.count;
+        if (run.asPoints) {
+            m_points.resize(run.count);
+            for (int i = run.first; i < end; ++i)
+                m_points[i - run.first] = shapes.at(m_order.at(i)).boundingRect().center();
+            painter.drawPoints(m_points.constData(), m_points.size());
+            continue;
+        }
+
+        switch (run.type) {
+        case ShapeType::Line:
+            // A bulk stroke unions overlapping segments, which only matches
+            // separate draws when the pen is opaque.
+            if (run.count > 1 && qAlpha(run.stroke) == 255) {
+                m_lines.resize(run.count);
+                for (int i = run.first; i < end; ++i) {
+                    const LineGeometry &l = shapes.at(m_order.at(i)).line;
+                    m_lines[i - run.first] = QLineF(l.x1, l.y1, l.x2, l.y2);
+                }
+                painter.drawLines(m_lines.constData(), m_lines.size());
+            } else {
+                for (int i = run.first; i < end; ++i) {
+                    const LineGeometry &l = shapes.at(m_order.at(i)).line;
+                    painter.drawLine(QLineF(l.x1, l.y1, l.x2, l.y2));
+                }
+            }
+            break;
+        case ShapeType::Rect:
+            m_rects.resize(run.count);
+            for (int i = run.first; i < end; ++i) {
+                const RectGeometry &r = shapes.at(m_order.at(i)).rect;
+                m_rects[i - run.first] = QRectF(r.x, r.y, r.width, r.height);
+            }
+            painter.drawRects(m_rects.constData(), m_rects.size());
+            break;
+        case ShapeType::FilledCircle:
+        case ShapeType::StrokeCircle:
+            for (int i = run.first; i < end; ++i) {
+                const CircleGeometry &c = shapes.at(m_order.at(i)).circle;
+                painter.drawEllipse(QPointF(c.cx, c.cy), qreal(c.radius), qreal(c.radius));
+            }
+            break;
+        case ShapeType::Triangle:
+            for (int i = run.first; i < end; ++i) {
+                const TriangleGeometry &t = shapes.at(m_order.at(i)).triangle;
+                const QPointF poly[3] = {
+                    QPointF(t.x1, t.y1),
+                    QPointF(t.x2, t.y2),
+                    QPointF(t.x3, t.y3)
+                };
+                painter.drawPolygon(poly, 3);
+            }
+            break;
+        case ShapeType::Instances:
+            for (int i = run.first; i < end; ++i)
+                drawInstances(painter, shapes, shapes.at(m_order.at(i)));
+            m_stateValid = false;
+            break;
+        case ShapeType::Text:
+            for (int i = run.first; i < end; ++i)
+                drawLabel(painter, shapes, shapes.at(m_order.at(i)));
+            m_stateValid = false;
+            break;
+        case ShapeType::Image:
+            // Already decoded and premultiplied; nothing is converted here.
+            for (int i = run.first; i < end; ++i) {
+                const Shape &s = shapes.at(m_order.at(i));
+                painter.drawImage(QRectF(s.image.x, s.image.y, s.image.width, s.image.height),
+                                  shapes.image(s));
+            }
+            break;
+        case ShapeType::Polyline:
+        case ShapeType::Polygon:
+            // Each path is one call however many points it has.
+            for (int i = run.first; i < end; ++i) {
+                const Shape &s = shapes.at(m_order.at(i));
+                const float *xy = shapes.points(s);
+                m_points.resize(int(s.path.count));
+                for (int k = 0; k < m_points.size(); ++k)
+                    m_points[k] = QPointF(xy[2 * k], xy[2 * k + 1]);
+                if (run.type == ShapeType::Polyline)
+                    painter.drawPolyline(m_points.constData(), m_points.size());
+                else
+                    painter.drawPolygon(m_points.constData(), m_points.size());
+            }
+            break;
+        }
+    }
+
+    if (aliased)
+        painter.setRenderHint(QPainter::Antialiasing, true);
+}
+
+bool SceneRenderer::beginSoftwareFills(QPainter &painter)
+{
+    // The rasterizer only reproduces antialiased source-over fills under a
+    // uniform scale + translate, without clipping, on a raster QImage.
+    if (!m_softwareFills || !painter.isActive() || painter.hasClipping()
+        || !painter.testRenderHint(QPainter::Antialiasing)
+        || painter.compositionMode() != QPainter::CompositionMode_SourceOver
+        || painter.opacity() < 1.0)
+        return false;
+
+    QPaintDevice *device = painter.device();
+    if (!device || device->devType() != QInternal::Image)
+        return false;
+
+    const QTransform t = painter.deviceTransform();
+    if (t.type() > QTransform::TxScale || t.m11() <= 0.0 || !qFuzzyCompare(t.m11(), t.m22()))
+        return false;
+
+    if (!m_fills.begin(static_cast<QImage *>(device)))
+        return false;
+    m_fills.setTransform(t.m11(), QPointF(t.dx(), t.dy()));
+    return true;
+}
+
+bool SceneRenderer::fillRun(QPainter &painter, const Run &run, const ShapeList &shapes)
+{
+    if (run.type != ShapeType::Rect && run.type != ShapeType::FilledCircle
+        && run.type != ShapeType::Triangle)
+        return false;
+
+    // Stroked shapes interleave a span fill with a brushless QPainter stroke
+    // so overlap order inside the run stays the same.
+    const bool stroked = qAlpha(run.stroke) != 0;
+    if (stroked) {
+        painter.setBrush(Qt::NoBrush);
+        m_stateValid = false;
+    }
+
+    const int end = run.first + run.count;
+    for (int i = run.first; i < end; ++i) {
+        const Shape &s = shapes.at(m_order.at(i));
+        switch (s.type) {
+        case ShapeType::Rect: {
+            const QRectF rect(s.rect.x, s.rect.y, s.rect.width, s.rect.height);
+            m_fills.fillRect(rect, run.fill);
+            if (stroked)
+                painter.drawRect(rect);
+            break;
+        }
+        case ShapeType::FilledCircle:
+            m_fills.fillCircle(QPointF(s.circle.cx, s.circle.cy), s.circle.radius, run.fill);
+            break;
+        case ShapeType::Triangle: {
+            const QPointF poly[3] = {
+                QPointF(s.triangle.x1, s.triangle.y1),
+                QPointF(s.triangle.x2, s.triangle.y2),
+                QPointF(s.triangle.x3, s.triangle.y3)
+            };
+            m_fills.fillTriangle(poly[0], poly[1], poly[2], run.fill);
+            if (stroked)
+                painter.drawPolygon(poly, 3);
+            break;
+        }
+        case ShapeType::StrokeCircle:
+        case ShapeType::Line:
+        case ShapeType::Polyline:
+        case ShapeType::Polygon:
+        case ShapeType::Instances:
+        case ShapeType::Text:
+        case ShapeType::Image:
+            break;
+        }
+    }
+    return true;
+}
+
+void SceneRenderer::drawInstances(QPainter &painter, const ShapeList &shapes, const Shape &set)
+{
+    const int count = int(set.instances.count);
+    const QTransform t = painter.deviceTransform();
+    const bool stamp = t.type() <= QTransform::TxScale && t.m11() > 0.0
+        && qFuzzyCompare(t.m11(), t.m22())
+        && painter.compositionMode() == QPainter::CompositionMode_SourceOver;
+    if (!stamp) {
+        for (int i = 0; i < count; ++i)
+            drawShape(painter, shapes.instanceShape(set, i));
+        return;
+    }
+
+    const Shape &templ = shapes.instanceTemplate(set);
+    const Instance *instances = shapes.instances(set);
+    const qreal scale = t.m11();
+    const bool antialiased = painter.testRenderHint(QPainter::Antialiasing);
+    const QRectF unitBounds = templ.boundingRect();
+    const qreal unitExtent = qMax(unitBounds.width(), unitBounds.height());
+
+    // Sprites are blitted 1:1 in device pixels. The world transform is set
+    // to undo whatever the engine adds on top (the device pixel ratio).
+    painter.save();
+    const QTransform extra = painter.worldTransform().inverted() * t;
+    painter.setWorldTransform(extra.inverted());
+
+    SpriteKey key;
+    std::memset(&key, 0, sizeof(key));
+    std::memcpy(key.geometry, &templ.triangle, sizeof(key.geometry));
+    key.penWidth = float(templ.penWidth * scale);
+    key.type = quint8(templ.type);
+    key.antialiased = antialiased;
+    key.hasFill = templ.hasFill();
+    key.hasStroke = templ.hasStroke();
+
+    for (int i = 0; i < count; ++i) {
+        const Instance &instance = instances[i];
+        QRgb fill = templ.fill;
+        QRgb stroke = templ.stroke;
+        if (instance.flags & Instance::HasColor) {
+            if (templ.hasFill())
+                fill = instance.color;
+            else
+                stroke = instance.color;
+        }
+        if (qAlpha(fill) == 0 && qAlpha(stroke) == 0)
+            continue;
+
+        int x = 0;
+        int y = 0;
+        snapQuarter(instance.x * scale + t.dx(), &x, &key.subX);
+        snapQuarter(instance.y * scale + t.dy(), &y, &key.subY);
+        key.scale = snapScale(instance.scale * scale, unitExtent);
+
+        auto it = m_sprites.find(key);
+        if (it == m_sprites.end()) {
+            Shape local = templ.placed(key.scale, key.subX * 0.25f, key.subY * 0.25f);
+            local.penWidth = key.penWidth;
+            const Sprite sprite = rasterizeSprite(local, antialiased);
+            // Masks plus the tint that will be made from them.
+            const QImage &mask = sprite.fillMask.isNull() ? sprite.strokeMask : sprite.fillMask;
+            const qint64 bytes = sprite.fillMask.sizeInBytes() + sprite.strokeMask.sizeInBytes()
+                               + 4 * qint64(mask.width()) * mask.height();
+            if (m_spriteBytes + bytes > MaxSpriteBytes) {
+                m_sprites.clear();
+                m_spriteBytes = 0;
+            }
+            m_spriteBytes += bytes;
+            it = m_sprites.insert(key, sprite);
+        }
+
+        if (!it->fillMask.isNull() || !it->strokeMask.isNull()) {
+            if (it->tinted.isNull() || it->tintFill != fill || it->tintStroke != stroke)
+                tintSprite(&*it, fill, stroke);
+            painter.drawImage(QPoint(x, y) + it->offset, it->tinted);
+        } else {
+            // Too large to cache: draw this one in device space directly.
+            Shape local = templ.placed(float(instance.scale * scale), float(instance.x * scale + t.dx()),
+                                       float(instance.y * scale + t.dy()));
+            local.fill = fill;
+            local.stroke = stroke;
+            local.penWidth = key.penWidth;
+            drawShape(painter, local);
+        }
+    }
+    painter.restore();
+}
+
+SceneRenderer::Sprite SceneRenderer::rasterizeSprite(const Shape &local, bool antialiased)
+{
+    Sprite sprite;
+    sprite.tintFill = 0;
+    sprite.tintStroke = 0;
+    const QRect pixels = local.boundingRect().toAlignedRect();
+    if (pixels.width() > MaxSpriteExtent || pixels.height() > MaxSpriteExtent || pixels.isEmpty())
+        return sprite;
+    sprite.offset = pixels.topLeft();
+
+    // Each part is drawn in opaque white, so its alpha is the coverage.
+    const QRgb white = qRgba(255, 255, 255, 255);
+    for (int part = 0; part < 2; ++part) {
+        Shape s = local;
+        s.fill = part == 0 ? (local.hasFill() ? white : 0) : 0;
+        s.stroke = part == 1 ? (local.hasStroke() ? white : 0) : 0;
+        if (!s.hasFill() && !s.hasStroke())
+            continue;
+
+        QImage image(pixels.size(), QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        QPainter sp(&image);
+        sp.setRenderHint(QPainter::Antialiasing, antialiased);
+        sp.translate(-pixels.topLeft());
+        drawShape(sp, s);
+        sp.end();
+        (part == 0 ? sprite.fillMask : sprite.strokeMask) = image.convertToFormat(QImage::Format_Alpha8);
+    }
+    return sprite;
+}
+
+void SceneRenderer::tintSprite(Sprite *sprite, QRgb fill, QRgb stroke)
+{
+    const QImage &mask = sprite->fillMask.isNull() ? sprite->strokeMask : sprite->fillMask;
+    if (sprite->tinted.size() != mask.size())
+        sprite->tinted = QImage(mask.size(), QImage::Format_ARGB32_Premultiplied);
+
+    // The stroke goes over the fill, as QPainter draws them.
+    const bool hasFill = !sprite->fillMask.isNull();
+    const bool hasStroke = !sprite->strokeMask.isNull();
+    for (int y = 0; y < mask.height(); ++y) {
+        const uchar *fillCoverage = hasFill ? sprite->fillMask.constScanLine(y) : nullptr;
+        const uchar *strokeCoverage = hasStroke ? sprite->strokeMask.constScanLine(y) : nullptr;
+        QRgb *dst = reinterpret_cast<QRgb *>(sprite->tinted.scanLine(y));
+        for (int x = 0; x < mask.width(); ++x) {
+            QRgb pixel = hasFill ? byteMul(fill, fillCoverage[x]) : 0;
+            if (hasStroke) {
+                const QRgb over = byteMul(stroke, strokeCoverage[x]);
+                pixel = over + byteMul(pixel, 255 - qAlpha(over));
+            }
+            dst[x] = pixel;
+        }
+    }
+    sprite->tintFill = fill;
+    sprite->tintStroke = stroke;
+}
+
+qreal SceneRenderer::viewScale(const QPainter &painter)
+{
+    // Scripts only ever scale uniformly, so the determinant gives the zoom
+    // including the device pixel ratio.
+    const QTransform t = painter.deviceTransform();
+    return qSqrt(qAbs(t.determinant()));
+}
+
+void SceneRenderer::applyState(QPainter &painter, const Run &run)
+{
+    // Consecutive runs often differ only in primitive; keep pen and brush.
+    if (m_stateValid && run.fill == m_currentFill && run.stroke == m_currentStroke
+        && run.penWidth == m_currentPenWidth)
+        return;
+
+    if (qAlpha(run.stroke) != 0)
+        painter.setPen(QPen(unpackColor(run.stroke), run.penWidth));
+    else
+        painter.setPen(Qt::NoPen);
+
+    if (qAlpha(run.fill) != 0)
+        painter.setBrush(unpackColor(run.fill));
+    else
+        painter.setBrush(Qt::NoBrush);
+
+    m_stateValid = true;
+    m_currentFill = run.fill;
+    m_currentStroke = run.stroke;
+    m_currentPenWidth = run.penWidth;
+}
+
+void SceneRenderer::drawShape(QPainter &p, const ShapeList &shapes, int index)
+{
+    const Shape &s = shapes.at(index);
+    switch (s.type) {
+    case ShapeType::Polyline:
+    case ShapeType::Polygon: {
+        const float *xy = shapes.points(s);
+        QVector<QPointF> points(int(s.path.count));
+        for (int k = 0; k < points.size(); ++k)
+            points[k] = QPointF(xy[2 * k], xy[2 * k + 1]);
+
+        if (s.hasStroke())
+            p.setPen(QPen(s.strokeColor(), s.penWidth));
+        else
+            p.setPen(Qt::NoPen);
+        if (s.type == ShapeType::Polygon && s.hasFill())
+            p.setBrush(s.fillColor());
+        else
+            p.setBrush(Qt::NoBrush);
+
+        if (s.type == ShapeType::Polyline)
+            p.drawPolyline(points.constData(), points.size());
+        else
+            p.drawPolygon(points.constData(), points.size());
+        break;
+    }
+    case ShapeType::Instances:
+        for (int i = 0; i < int(s.instances.count); ++i)
+            drawShape(p, shapes.instanceShape(s, i));
+        break;
+    case ShapeType::Text:
+        drawLabel(p, shapes, s);
+        break;
+    case ShapeType::Image:
+        p.drawImage(QRectF(s.image.x, s.image.y, s.image.width, s.image.height), shapes.image(s));
+        break;
+    default:
+        drawShape(p, s);
+        break;
+    }
+}
+
+void SceneRenderer::drawShape(QPainter &p, const Shape &s)
+{
+    // Rendering intentionally mirrors ScriptCanvas packing rules.
+    switch (s.type) {
+    case ShapeType::FilledCircle: {
+        const QPointF c(s.circle.cx, s.circle.cy);
+        const qreal r = s.circle.radius;
+        p.setPen(Qt::NoPen);
+        p.setBrush(s.fillColor());
+        p.drawEllipse(c, r, r);
+        break;
+    }
+    case ShapeType::StrokeCircle: {
+        const QPointF c(s.circle.cx, s.circle.cy);
+        const qreal r = s.circle.radius;
+        QPen pen(s.strokeColor(), s.penWidth);
+        p.setPen(pen);
+        p.setBrush(Qt::NoBrush);
+        p.drawEllipse(c, r, r);
+        break;
+    }
+    case ShapeType::Rect: {
+        const QRectF rect(s.rect.x, s.rect.y, s.rect.width, s.rect.height);
+        QPen pen;
+        if (s.hasStroke()) {
+            pen = QPen(s.strokeColor(), s.penWidth);
+        } else {
+            pen = Qt::NoPen;
+        }
+        p.setPen(pen);
+
+        if (s.hasFill())
+            p.setBrush(s.fillColor());
+        else
+            p.setBrush(Qt::NoBrush);
+
+        p.drawRect(rect);
+        break;
+    }
+    case ShapeType::Triangle: {
+        const QPointF poly[3] = {
+            QPointF(s.triangle.x1, s.triangle.y1),
+            QPointF(s.triangle.x2, s.triangle.y2),
+            QPointF(s.triangle.x3, s.triangle.y3)
+        };
+
+        QPen pen;
+        if (s.hasStroke())
+            pen = QPen(s.strokeColor(), s.penWidth);
+        else
+            pen = Qt::NoPen;
+
+        p.setPen(pen);
+        if (s.hasFill())
+            p.setBrush(s.fillColor());
+        else
+            p.setBrush(Qt::NoBrush);
+
+        p.drawPolygon(poly, 3);
+        break;
+    }
+    case ShapeType::Line: {
+        QPen pen(s.strokeColor(), s.penWidth);
+        p.setPen(pen);
+        p.setBrush(Qt::NoBrush);
+        p.drawLine(QPointF(s.line.x1, s.line.y1), QPointF(s.line.x2, s.line.y2));
+        break;
+    }
+    case ShapeType::Polyline:
+    case ShapeType::Polygon:
+    case ShapeType::Instances:
+    case ShapeType::Text:
+    case ShapeType::Image:
+        // Need the owning ShapeList; see the overload above.
+        break;
+    }
+}
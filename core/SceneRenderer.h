@@ -0,0 +1,136 @@
+#ifndef SCENERENDERER_H
+#define SCENERENDERER_H
+
+#include <QHash>
+#include <QImage>
+#include <QLineF>
+#include <QRectF>
+#include <QVector>
+
+#include "FillRasterizer.h"
+#include "Shapes.h"
+
+class QPainter;
+
+// Level-of-detail policy, in device pixels. Shapes whose projected extent is
+// below cullExtent are skipped, those below pointExtent become a single
+// point, and hairline strokes lose antialiasing when the view scale drops
+// under aliasedHairlineScale.
+struct LevelOfDetail
+{
+    LevelOfDetail()
+        : enabled(true)
+        , cullExtent(0.1)
+        , pointExtent(1.0)
+        , aliasedHairlineScale(0.5)
+    {}
+
+    bool  enabled;
+    qreal cullExtent;
+    qreal pointExtent;
+    qreal aliasedHairlineScale;
+};
+
+// Turns shape records into QPainter calls. Shared by the on-screen canvas and
+// its backing store so every path rasterizes a scene exactly the same way.
+//
+// Shapes are first compiled into runs of consecutive shapes that share a
+// primitive, pen and brush; each run sets painter state once and is issued
+// as bulk drawLines()/drawRects() calls where that cannot change the result.
+// Fills of rects, circles and triangles go through FillRasterizer when the
+// painter targets a plain 32-bit QImage. Instance sets are stamped from
+// pre-rasterized coverage masks, tinted per instance, when the view is a
+// uniform scale. Renderers keep scratch buffers and the sprite cache, so use
+// one renderer per thread.
+class SceneRenderer
+{
+public:
+    SceneRenderer();
+
+    void setLevelOfDetail(const LevelOfDetail &lod);
+    LevelOfDetail levelOfDetail() const;
+
+    // Software span fills; on by default, QPainter is used when off or when
+    // the painter state is not one the rasterizer reproduces.
+    void setSoftwareFills(bool enabled);
+    bool softwareFills() const;
+
+    void draw(QPainter &painter, const ShapeList &shapes);
+    // Draws only the listed indices, which must already be in paint order.
+    void draw(QPainter &painter, const ShapeList &shapes, const QVector<int> &indices);
+
+    // Reference single-shape path; also used for shapes that do not batch.
+    static void drawShape(QPainter &painter, const ShapeList &shapes, int index);
+    // Same for a plain primitive (no paths or instance sets).
+    static void drawShape(QPainter &painter, const Shape &shape);
+
+private:
+    struct Run
+    {
+        ShapeType type;
+        bool      asPoints;
+        bool      aliased;
+        QRgb      fill;
+        QRgb      stroke;
+        float     penWidth;
+        int       first;
+        int       count;
+    };
+
+    void compile(const ShapeList &shapes, const int *indices, int count, qreal scale);
+    void execute(QPainter &painter, const ShapeList &shapes);
+    void applyState(QPainter &painter, const Run &run);
+    bool beginSoftwareFills(QPainter &painter);
+    bool fillRun(QPainter &painter, const Run &run, const ShapeList &shapes);
+    void drawInstances(QPainter &painter, const ShapeList &shapes, const Shape &set);
+    static qreal viewScale(const QPainter &painter);
+
+    // A template rasterized at one (snapped) device scale and quarter-pixel
+    // offset. Colors are not part of it: the masks are tinted when drawn.
+    // Zero-initialized so it can be hashed and compared bytewise.
+    struct SpriteKey
+    {
+        float   geometry[6];
+        float   penWidth;
+        float   scale;
+        quint8  type;
+        quint8  subX;
+        quint8  subY;
+        quint8  antialiased;
+        quint8  hasFill;
+        quint8  hasStroke;
+    };
+    // Alpha8 coverage of the fill and of the stroke (null when the template
+    // has none), plus the last tint made from them: neighbouring instances
+    // usually share their colors.
+    struct Sprite
+    {
+        QImage fillMask;
+        QImage strokeMask;
+        QPoint offset;
+        QImage tinted;
+        QRgb   tintFill;
+        QRgb   tintStroke;
+    };
+    friend bool operator==(const SpriteKey &a, const SpriteKey &b);
+    friend uint qHash(const SpriteKey &key, uint seed);
+    static Sprite rasterizeSprite(const Shape &local, bool antialiased);
+    static void tintSprite(Sprite *sprite, QRgb fill, QRgb stroke);
+
+    QVector<Run>     m_runs;
+    QVector<int>     m_order;
+    QVector<QLineF>  m_lines;
+    QVector<QRectF>  m_rects;
+    QVector<QPointF> m_points;
+    LevelOfDetail    m_lod;
+    FillRasterizer   m_fills;
+    QHash<SpriteKey, Sprite> m_sprites;
+    qint64           m_spriteBytes;
+    bool             m_softwareFills;
+    bool             m_stateValid;
+    QRgb             m_currentFill;
+    QRgb             m_currentStroke;
+    float            m_currentPenWidth;
+};
+
+#endif
@@ -1,37 +1,258 @@
 #include "ScriptCanvas.h"
 
 #include "CanvasState.h"
+#include "ColorTable.h"
+#include "ImageCache.h"
+
+#include <QHash>
+#include <QStringList>
+
+namespace {
+
+// Bulk calls take either a color name or a QColor produced by Qt.rgba().
+bool toColor(const QVariant &value, QColor *color)
+{
+    if (value.userType() == QMetaType::QColor)
+        *color = value.value<QColor>();
+    else
+        *color = ColorTable::color(value.toString());
+    return color->isValid();
+}
+
+// Decodes whole groups of stride numbers; a trailing partial group is ignored.
+template <typename MakeShape>
+ShapeList decodeShapes(const QVariantList &coords, int stride, MakeShape makeShape)
+{
+    ShapeList shapes;
+    const int count = coords.size() / stride;
+    shapes.reserve(count);
+
+    qreal v[6];
+    QVariantList::const_iterator it = coords.constBegin();
+    for (int i = 0; i < count; ++i) {
+        for (int k = 0; k < stride; ++k, ++it)
+            v[k] = it->toDouble();
+        shapes.append(makeShape(v));
+    }
+    return shapes;
+}
+
+// Flattens a script point array into interleaved floats for ShapeList.
+QVector<float> decodePoints(const QVariantList &points)
+{
+    QVector<float> xy(points.size() / 2 * 2);
+    for (int i = 0; i < xy.size(); ++i)
+        xy[i] = float(points.at(i).toDouble());
+    return xy;
+}
+
+// An absent key means transparent; a present but unknown color fails.
+bool templateColor(const QVariantMap &map, const QString &key, QRgb *packed)
+{
+    *packed = 0;
+    if (!map.contains(key))
+        return true;
+    QColor color;
+    if (!toColor(map.value(key), &color))
+        return false;
+    *packed = packColor(color);
+    return true;
+}
+
+bool decodeTemplate(const QVariantMap &map, Shape *templ)
+{
+    QRgb fill;
+    QRgb stroke;
+    if (!templateColor(map, QStringLiteral("fill"), &fill)
+        || !templateColor(map, QStringLiteral("stroke"), &stroke))
+        return false;
+
+    const QString shape = map.value(QStringLiteral("shape"), QStringLiteral("filledCircle")).toString();
+    const qreal penWidth = map.value(QStringLiteral("penWidth"), 1.0).toDouble();
+    const auto number = [&](const char *key) { return map.value(QLatin1String(key)).toDouble(); };
+
+    if (shape == QLatin1String("filledCircle")) {
+        *templ = Shape::makeFilledCircle(QPointF(), number("radius"), fill);
+    } else if (shape == QLatin1String("circle")) {
+        *templ = Shape::makeStrokeCircle(QPointF(), number("radius"), stroke, penWidth);
+    } else if (shape == QLatin1String("rect")) {
+        const qreal width = number("width");
+        const qreal height = number("height");
+        *templ = Shape::makeRect(QRectF(-width / 2, -height / 2, width, height), fill, stroke, penWidth);
+    } else if (shape == QLatin1String("triangle")) {
+        *templ = Shape::makeTriangle(QPointF(number("x1"), number("y1")), QPointF(number("x2"), number("y2")),
+                                     QPointF(number("x3"), number("y3")), fill, stroke, penWidth);
+    } else if (shape == QLatin1String("line")) {
+        *templ = Shape::makeLine(QPointF(number("x1"), number("y1")), QPointF(number("x2"), number("y2")),
+                                 stroke, penWidth);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Parses "[bold] [italic] [<size>[px]] [family...]"; scripts repeat the same
+// few fonts, so the parsed result is remembered per thread.
+QFont decodeFont(const QString &spec)
+{
+    static thread_local QHash<QString, QFont> fonts;
+    const auto known = fonts.constFind(spec);
+    if (known != fonts.constEnd())
+        return *known;
+
+    QFont font;
+    font.setPixelSize(12);
+    QStringList family;
+    const QStringList words = spec.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+    for (const QString &word : words) {
+        QString size = word;
+        if (size.endsWith(QLatin1String("px")))
+            size.chop(2);
+        bool isSize = false;
+        const double pixels = size.toDouble(&isSize);
+
+        if (word == QLatin1String("bold"))
+            font.setBold(true);
+        else if (word == QLatin1String("italic"))
+            font.setItalic(true);
+        else if (isSize && family.isEmpty())
+            font.setPixelSize(qMax(1, qRound(pixels)));
+        else
+            family.append(word);
+    }
+    if (!family.isEmpty())
+        font.setFamily(family.join(QLatin1Char(' ')));
+
+    if (fonts.size() >= 64)
+        fonts.clear();
+    fonts.insert(spec, font);
+    return font;
+}
+
+} // namespace
 
 ScriptCanvas::ScriptCanvas(CanvasState *state, QObject *parent)
     : QObject(parent)
     , m_state(state)
+    , m_openBatches(0)
+    , m_capturing(false)
+    , m_capture(nullptr)
 {
 }
 
 void ScriptCanvas::clear()
 {
-    if (m_state)
+    if (!m_state)
+        return;
+    if (m_capturing)
+        m_capture->clear();
+    else
         m_state->clearShapes();
 }
 
+void ScriptCanvas::layer(const QString &name)
+{
+    if (!m_state)
+        return;
+
+    // Selecting creates the layer now, so z-order follows first use.
+    if (m_state->selectLayer(name) < 0) {
+        emit scriptError(tr("Too many layers; a canvas holds at most %1").arg(int(CanvasState::MaxLayers)));
+        return;
+    }
+    m_layerName = name;
+    m_removedLayers.remove(name);
+    if (m_capturing)
+        m_capture = &m_captured[name];
+    if (!m_runLayers.contains(name)) {
+        m_runLayers.insert(name);
+        // Capture lists outlive the run and only clear here, so a re-run can
+        // refill last run's pools instead of growing new ones.
+        if (m_capturing)
+            m_capture->clear();
+        else
+            m_state->clearShapes();
+    }
+}
+
+void ScriptCanvas::removeLayer(const QString &name)
+{
+    if (!m_state || name.isEmpty())
+        return;
+
+    // Only states without undo let a layer go mid-run (see
+    // CanvasState::removeLayer()); elsewhere it stays, empty, until the run
+    // is merged.
+    if (m_layerName == name)
+        layer(QString());
+    m_state->removeLayer(name);
+    if (!m_capturing)
+        return;
+
+    m_runLayers.remove(name);
+    m_captured.remove(name);
+    m_removedLayers.insert(name);
+}
+
+void ScriptCanvas::beginRun()
+{
+    m_runLayers.clear();
+    m_removedLayers.clear();
+    m_capturing = true;
+    layer(QString());
+}
+
+void ScriptCanvas::endRun()
+{
+    if (!m_capturing)
+        return;
+
+    m_capturing = false;
+    m_capture = nullptr;
+    for (auto it = m_captured.begin(); it != m_captured.end();) {
+        // Lists of layers this run left alone would only hold on to memory.
+        if (!m_runLayers.contains(it.key())) {
+            it = m_captured.erase(it);
+            continue;
+        }
+        const int layer = m_state ? m_state->selectLayer(it.key()) : -1;
+        if (layer >= 0)
+            m_state->replaceShapes(layer, it.value());
+        ++it;
+    }
+    if (m_state)
+        m_state->selectLayer(QString());
+    m_layerName.clear();
+}
+
+void ScriptCanvas::addShape(const Shape &shape)
+{
+    if (m_capturing)
+        m_capture->append(shape);
+    else
+        m_state->addShape(shape);
+}
+
+void ScriptCanvas::addShapes(const ShapeList &shapes)
+{
+    if (m_capturing)
+        *m_capture += shapes;
+    else
+        m_state->addShapes(shapes);
+}
+
 void ScriptCanvas::line(qreal x1, qreal y1, qreal x2, qreal y2, const QColor &color, qreal width)
 {
     if (!m_state)
         return;
 
     // Store the raw geometry so CanvasWidget can paint deterministically later.
-    Shape s;
-    s.type = ShapeType::Line;
-    s.p1 = QPointF(x1, y1);
-    s.p2 = QPointF(x2, y2);
-    s.strokeColor = color;
-    s.penWidth = width;
-    m_state->addShape(s);
+    addShape(Shape::makeLine(QPointF(x1, y1), QPointF(x2, y2), packColor(color), width));
 }
 
 void ScriptCanvas::line(qreal x1, qreal y1, qreal x2, qreal y2, const QString &colorStr, qreal width)
 {
-    QColor color(colorStr);
+    const QColor color = ColorTable::color(colorStr);
     if (color.isValid()) {
         line(x1, y1, x2, y2, color, width);
     }
@@ -42,20 +263,14 @@ void ScriptCanvas::rect(qreal x, qreal y, qreal width, qreal height, const QColo
     if (!m_state)
         return;
 
-    Shape s;
-    s.type = ShapeType::Rect;
-    s.p1 = QPointF(x, y);
-    s.p2 = QPointF(width, height);
-    s.fillColor = fillColor;
-    s.strokeColor = strokeColor;
-    s.penWidth = penWidth;
-    m_state->addShape(s);
+    addShape(Shape::makeRect(QRectF(x, y, width, height),
+                                      packColor(fillColor), packColor(strokeColor), penWidth));
 }
 
 void ScriptCanvas::rect(qreal x, qreal y, qreal width, qreal height, const QString &fillColorStr, const QString &strokeColorStr, qreal penWidth)
 {
-    QColor fillColor(fillColorStr);
-    QColor strokeColor(strokeColorStr);
+    const QColor fillColor = ColorTable::color(fillColorStr);
+    const QColor strokeColor = ColorTable::color(strokeColorStr);
     if (fillColor.isValid() && strokeColor.isValid()) {
         rect(x, y, width, height, fillColor, strokeColor, penWidth);
     }
@@ -66,19 +281,12 @@ void ScriptCanvas::circle(qreal x, qreal y, qreal radius, const QColor &strokeCo
     if (!m_state)
         return;
 
-    // Stash the radius in p2.x to keep the Shape struct small.
-    Shape s;
-    s.type = ShapeType::StrokeCircle;
-    s.p1 = QPointF(x, y);
-    s.p2 = QPointF(radius, 0);
-    s.strokeColor = strokeColor;
-    s.penWidth = penWidth;
-    m_state->addShape(s);
+    addShape(Shape::makeStrokeCircle(QPointF(x, y), radius, packColor(strokeColor), penWidth));
 }
 
 void ScriptCanvas::circle(qreal x, qreal y, qreal radius, const QString &strokeColorStr, qreal penWidth)
 {
-    QColor strokeColor(strokeColorStr);
+    const QColor strokeColor = ColorTable::color(strokeColorStr);
     if (strokeColor.isValid()) {
         circle(x, y, radius, strokeColor, penWidth);
     }
@@ -89,17 +297,12 @@ void ScriptCanvas::filledCircle(qreal x, qreal y, qreal radius, const QColor &fi
     if (!m_state)
         return;
 
-    Shape s;
-    s.type = ShapeType::FilledCircle;
-    s.p1 = QPointF(x, y);
-    s.p2 = QPointF(radius, 0);
-    s.fillColor = fillColor;
-    m_state->addShape(s);
+    addShape(Shape::makeFilledCircle(QPointF(x, y), radius, packColor(fillColor)));
 }
 
 void ScriptCanvas::filledCircle(qreal x, qreal y, qreal radius, const QString &fillColorStr)
 {
-    QColor fillColor(fillColorStr);
+    const QColor fillColor = ColorTable::color(fillColorStr);
     if (fillColor.isValid()) {
         filledCircle(x, y, radius, fillColor);
     }
@@ -110,26 +313,168 @@ void ScriptCanvas::triangle(qreal x1, qreal y1, qreal x2, qreal y2, qreal x3, qr
     if (!m_state)
         return;
 
-    Shape s;
-    s.type = ShapeType::Triangle;
-    s.p1 = QPointF(x1, y1);
-    s.p2 = QPointF(x2, y2);
-    s.p3 = QPointF(x3, y3);
-    s.fillColor = fillColor;
-    s.strokeColor = strokeColor;
-    s.penWidth = penWidth;
-    m_state->addShape(s);
+    addShape(Shape::makeTriangle(QPointF(x1, y1), QPointF(x2, y2), QPointF(x3, y3),
+                                          packColor(fillColor), packColor(strokeColor), penWidth));
 }
 
 void ScriptCanvas::triangle(qreal x1, qreal y1, qreal x2, qreal y2, qreal x3, qreal y3, const QString &fillColorStr, const QString &strokeColorStr, qreal penWidth)
 {
-    QColor fillColor(fillColorStr);
-    QColor strokeColor(strokeColorStr);
+    const QColor fillColor = ColorTable::color(fillColorStr);
+    const QColor strokeColor = ColorTable::color(strokeColorStr);
     if (fillColor.isValid() && strokeColor.isValid()) {
         triangle(x1, y1, x2, y2, x3, y3, fillColor, strokeColor, penWidth);
     }
 }
 
+void ScriptCanvas::lines(const QVariantList &coords, const QVariant &color, qreal width)
+{
+    QColor stroke;
+    if (!m_state || !toColor(color, &stroke))
+        return;
+
+    const QRgb packed = packColor(stroke);
+    addShapes(decodeShapes(coords, 4, [=](const qreal *v) {
+        return Shape::makeLine(QPointF(v[0], v[1]), QPointF(v[2], v[3]), packed, width);
+    }));
+}
+
+void ScriptCanvas::rects(const QVariantList &coords, const QVariant &fillColor, const QVariant &strokeColor, qreal penWidth)
+{
+    QColor fill;
+    QColor stroke;
+    if (!m_state || !toColor(fillColor, &fill) || !toColor(strokeColor, &stroke))
+        return;
+
+    const QRgb packedFill = packColor(fill);
+    const QRgb packedStroke = packColor(stroke);
+    addShapes(decodeShapes(coords, 4, [=](const qreal *v) {
+        return Shape::makeRect(QRectF(v[0], v[1], v[2], v[3]), packedFill, packedStroke, penWidth);
+    }));
+}
+
+void ScriptCanvas::circles(const QVariantList &coords, const QVariant &strokeColor, qreal penWidth)
+{
+    QColor stroke;
+    if (!m_state || !toColor(strokeColor, &stroke))
+        return;
+
+    const QRgb packed = packColor(stroke);
+    addShapes(decodeShapes(coords, 3, [=](const qreal *v) {
+        return Shape::makeStrokeCircle(QPointF(v[0], v[1]), v[2], packed, penWidth);
+    }));
+}
+
+void ScriptCanvas::filledCircles(const QVariantList &coords, const QVariant &fillColor)
+{
+    QColor fill;
+    if (!m_state || !toColor(fillColor, &fill))
+        return;
+
+    const QRgb packed = packColor(fill);
+    addShapes(decodeShapes(coords, 3, [=](const qreal *v) {
+        return Shape::makeFilledCircle(QPointF(v[0], v[1]), v[2], packed);
+    }));
+}
+
+void ScriptCanvas::triangles(const QVariantList &coords, const QVariant &fillColor, const QVariant &strokeColor, qreal penWidth)
+{
+    QColor fill;
+    QColor stroke;
+    if (!m_state || !toColor(fillColor, &fill) || !toColor(strokeColor, &stroke))
+        return;
+
+    const QRgb packedFill = packColor(fill);
+    const QRgb packedStroke = packColor(stroke);
+    addShapes(decodeShapes(coords, 6, [=](const qreal *v) {
+        return Shape::makeTriangle(QPointF(v[0], v[1]), QPointF(v[2], v[3]), QPointF(v[4], v[5]),
+                                   packedFill, packedStroke, penWidth);
+    }));
+}
+
+void ScriptCanvas::polyline(const QVariantList &points, const QVariant &color, qreal width)
+{
+    QColor stroke;
+    if (!m_state || points.size() < 4 || !toColor(color, &stroke))
+        return;
+
+    const QVector<float> xy = decodePoints(points);
+    ShapeList shapes;
+    shapes.appendPath(ShapeType::Polyline, xy.constData(), xy.size() / 2, 0, packColor(stroke), width);
+    addShapes(shapes);
+}
+
+void ScriptCanvas::polygon(const QVariantList &points, const QVariant &fillColor, const QVariant &strokeColor, qreal penWidth)
+{
+    QColor fill;
+    QColor stroke;
+    if (!m_state || points.size() < 6 || !toColor(fillColor, &fill) || !toColor(strokeColor, &stroke))
+        return;
+
+    const QVector<float> xy = decodePoints(points);
+    ShapeList shapes;
+    shapes.appendPath(ShapeType::Polygon, xy.constData(), xy.size() / 2, packColor(fill), packColor(stroke), penWidth);
+    addShapes(shapes);
+}
+
+void ScriptCanvas::instances(const QVariantMap &templ, const QVariantList &positions,
+                             const QVariantList &scales, const QVariantList &colors)
+{
+    Shape shape;
+    if (!m_state || positions.size() < 2 || !decodeTemplate(templ, &shape))
+        return;
+
+    QVector<Instance> instances(positions.size() / 2);
+    for (int i = 0; i < instances.size(); ++i) {
+        Instance &instance = instances[i];
+        instance.x = float(positions.at(2 * i).toDouble());
+        instance.y = float(positions.at(2 * i + 1).toDouble());
+        instance.scale = i < scales.size() ? float(scales.at(i).toDouble()) : 1.0f;
+        instance.color = 0;
+        instance.flags = 0;
+        QColor color;
+        if (i < colors.size() && toColor(colors.at(i), &color)) {
+            instance.color = packColor(color);
+            instance.flags |= Instance::HasColor;
+        }
+    }
+
+    ShapeList shapes;
+    shapes.appendInstances(shape, instances.constData(), instances.size());
+    addShapes(shapes);
+}
+
+void ScriptCanvas::text(qreal x, qreal y, const QString &text, const QString &font, const QVariant &color)
+{
+    QColor fill;
+    if (!m_state || text.isEmpty() || !toColor(color, &fill))
+        return;
+
+    ShapeList shapes;
+    shapes.appendText(QPointF(x, y), text, decodeFont(font), packColor(fill));
+    addShapes(shapes);
+}
+
+void ScriptCanvas::image(qreal x, qreal y, const QString &key, qreal width, qreal height)
+{
+    if (!m_state || key.isEmpty())
+        return;
+
+    // Transport deliveries win over files so editors can override assets.
+    ImageCache &cache = ImageCache::instance();
+    QImage image = cache.image(key);
+    if (image.isNull())
+        image = cache.load(m_imageDirectory, key);
+    if (image.isNull()) {
+        emit message(tr("Unknown image: %1").arg(key));
+        return;
+    }
+
+    const QSizeF size = width > 0.0 && height > 0.0 ? QSizeF(width, height) : QSizeF(image.size());
+    ShapeList shapes;
+    shapes.appendImage(QRectF(QPointF(x, y), size), image);
+    addShapes(shapes);
+}
+
 void ScriptCanvas::setBackground(const QColor &color)
 {
     if (m_state)
@@ -138,7 +483,7 @@ void ScriptCanvas::setBackground(const QColor &color)
 
 void ScriptCanvas::setBackground(const QString &colorStr)
 {
-    QColor color(colorStr);
+    const QColor color = ColorTable::color(colorStr);
     if (color.isValid()) {
         setBackground(color);
     }
@@ -150,6 +495,31 @@ void ScriptCanvas::setZoom(qreal zoom)
         m_state->setZoomFactor(zoom);
 }
 
+void ScriptCanvas::beginBatch()
+{
+    if (!m_state)
+        return;
+
+    ++m_openBatches;
+    m_state->beginBatch(tr("Script Batch"));
+}
+
+void ScriptCanvas::endBatch()
+{
+    // Ignore unbalanced calls so scripts cannot close batches they did not open.
+    if (!m_state || m_openBatches == 0)
+        return;
+
+    --m_openBatches;
+    m_state->endBatch();
+}
+
+void ScriptCanvas::endOpenBatches()
+{
+    while (m_openBatches > 0)
+        endBatch();
+}
+
 void ScriptCanvas::print(const QString &msg)
 {
     // Runner window logs this text so script authors can get feedback.
@@ -158,6 +528,23 @@ void ScriptCanvas::print(const QString &msg)
 
 ShapeList ScriptCanvas::shapes() const
 {
+    if (m_capture)
+        return *m_capture;
     return m_state ? m_state->shapes() : ShapeList();
 }
 
+void ScriptCanvas::setImageDirectory(const QString &path)
+{
+    m_imageDirectory = path;
+}
+
+QString ScriptCanvas::imageDirectory() const
+{
+    return m_imageDirectory;
+}
+
+QStringList ScriptCanvas::removedLayers() const
+{
+    return m_removedLayers.values();
+}
+
@@ -3,7 +3,11 @@
 
 #include <QObject>
 #include <QColor>
+#include <QHash>
+#include <QSet>
 #include <QString>
+#include <QStringList>
+#include <QVariant>
 #include "Shapes.h"
 
 class CanvasState;
@@ -15,7 +19,20 @@ class ScriptCanvas : public QObject
 public:
     explicit ScriptCanvas(CanvasState *state, QObject *parent = nullptr);
 
+    // Clears the current layer.
     Q_INVOKABLE void clear();
+    // Directs the following calls to the named layer ("" is the default one).
+    // The first time a run selects a layer it starts empty; layers a run
+    // never selects keep what earlier runs drew, so scripts can update an
+    // overlay without repainting a static background. Past
+    // CanvasState::MaxLayers layers, selecting a new one raises a script
+    // error and the current layer stays selected.
+    Q_INVOKABLE void layer(const QString &name);
+    // Drops a layer a script no longer uses, so it stops costing memory and
+    // frees its slot. In a run, this takes effect on the shared canvas when
+    // the run is merged (see removedLayers()); selecting the layer again
+    // later in the run brings it back, on top.
+    Q_INVOKABLE void removeLayer(const QString &name);
     Q_INVOKABLE void line(qreal x1, qreal y1, qreal x2, qreal y2, const QColor &color, qreal width = 1.0);
     Q_INVOKABLE void line(qreal x1, qreal y1, qreal x2, qreal y2, const QString &colorStr, qreal width = 1.0);
     Q_INVOKABLE void rect(qreal x, qreal y, qreal width, qreal height, const QColor &fillColor, const QColor &strokeColor, qreal penWidth = 1.0);
@@ -26,19 +43,81 @@ public:
     Q_INVOKABLE void filledCircle(qreal x, qreal y, qreal radius, const QString &fillColorStr);
     Q_INVOKABLE void triangle(qreal x1, qreal y1, qreal x2, qreal y2, qreal x3, qreal y3, const QColor &fillColor, const QColor &strokeColor, qreal penWidth = 1.0);
     Q_INVOKABLE void triangle(qreal x1, qreal y1, qreal x2, qreal y2, qreal x3, qreal y3, const QString &fillColorStr, const QString &strokeColorStr, qreal penWidth = 1.0);
+    // Bulk variants take a flat number array per shape type, e.g.
+    // lines([x1, y1, x2, y2, ...], color), and append everything as one undo
+    // step. Colors may be strings or Qt.rgba() values.
+    Q_INVOKABLE void lines(const QVariantList &coords, const QVariant &color, qreal width = 1.0);
+    Q_INVOKABLE void rects(const QVariantList &coords, const QVariant &fillColor, const QVariant &strokeColor, qreal penWidth = 1.0);
+    Q_INVOKABLE void circles(const QVariantList &coords, const QVariant &strokeColor, qreal penWidth = 1.0);
+    Q_INVOKABLE void filledCircles(const QVariantList &coords, const QVariant &fillColor);
+    Q_INVOKABLE void triangles(const QVariantList &coords, const QVariant &fillColor, const QVariant &strokeColor, qreal penWidth = 1.0);
+    // Paths take a flat [x0, y0, x1, y1, ...] array and become one shape
+    // whatever their length. Polylines need two points, polygons three.
+    Q_INVOKABLE void polyline(const QVariantList &points, const QVariant &color, qreal width = 1.0);
+    Q_INVOKABLE void polygon(const QVariantList &points, const QVariant &fillColor, const QVariant &strokeColor, qreal penWidth = 1.0);
+    // Stamps one template at many positions as a single shape, e.g.
+    // instances({shape: "filledCircle", radius: 2, fill: "red"}, [x0, y0, ...]).
+    // Templates are filledCircle, circle, rect (centered), triangle or line,
+    // relative to each position. Optional per-instance scales and colors may
+    // be shorter than the position list; missing entries keep the template.
+    Q_INVOKABLE void instances(const QVariantMap &templ, const QVariantList &positions,
+                               const QVariantList &scales = QVariantList(),
+                               const QVariantList &colors = QVariantList());
+    // Draws a label whose baseline starts at (x, y). font is a CSS-like
+    // shorthand such as "bold 14px Sans"; size and family are optional and
+    // default to 12 px in the application font.
+    Q_INVOKABLE void text(qreal x, qreal y, const QString &text, const QString &font, const QVariant &color);
+    // Draws a cached image into (x, y, width, height); a zero size keeps the
+    // image's own. key names an image delivered over the transport or a file
+    // relative to imageDirectory().
+    Q_INVOKABLE void image(qreal x, qreal y, const QString &key, qreal width = 0.0, qreal height = 0.0);
     Q_INVOKABLE void setBackground(const QColor &color);
     Q_INVOKABLE void setBackground(const QString &colorStr);
     Q_INVOKABLE void setZoom(qreal zoom);
+    // Lets scripts hold back repaints while emitting many shapes at once.
+    Q_INVOKABLE void beginBatch();
+    Q_INVOKABLE void endBatch();
     // Feeds the console in ScriptRunnerWindow via the message signal.
     Q_INVOKABLE void print(const QString &msg);
 
+    // The current layer; during a run, what the script has drawn into it so
+    // far rather than what the state still shows.
     ShapeList shapes() const;
+    // Brackets a script run. Shapes are collected per layer while the script
+    // executes and endRun() hands each touched layer to
+    // CanvasState::replaceShapes(), so only what differs from the previous
+    // run is replaced (and repainted). The default layer is always touched.
+    void beginRun();
+    void endRun();
+    void setImageDirectory(const QString &path);
+    QString imageDirectory() const;
+    // Closes batches a script opened but never ended (e.g. after an exception).
+    void endOpenBatches();
+    // Layers the last run removed and did not select again, for hosts that
+    // merge the run into another CanvasState.
+    QStringList removedLayers() const;
 
 signals:
     void message(const QString &text);
+    // A call the script must not get away with, e.g. one layer too many.
+    // Engine backends raise it as an exception in the running script.
+    void scriptError(const QString &text);
 
 private:
+    void addShape(const Shape &shape);
+    void addShapes(const ShapeList &shapes);
+
     CanvasState *m_state;
+    int          m_openBatches;
+    QString      m_imageDirectory;
+    QSet<QString> m_runLayers;
+    QSet<QString> m_removedLayers;
+    bool         m_capturing;
+    QString      m_layerName;
+    // Kept across runs as reusable storage; m_capture points into it at the
+    // selected layer's list while capturing.
+    QHash<QString, ShapeList> m_captured;
+    ShapeList   *m_capture;
 };
 
 #endif
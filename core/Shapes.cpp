@@ -0,0 +1,550 @@
+#include "Shapes.h"
+
+#include <QFontMetricsF>
+#include <QLineF>
+#include <QtMath>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// QVector::operator+= adopts the other vector's buffer when this one is
+// empty, which would throw away the capacity a cleared pool kept. Copy into
+// that capacity instead when it is large enough.
+template <typename T>
+void appendPool(QVector<T> &pool, const QVector<T> &other)
+{
+    if (!pool.isEmpty() || pool.capacity() < other.size()) {
+        pool += other;
+        return;
+    }
+    pool.resize(other.size());
+    std::copy(other.constBegin(), other.constEnd(), pool.begin());
+}
+
+// QVector::clear() detaches a shared vector by copying it, only to destroy
+// the copy. A fresh buffer of the same capacity serves the same purpose.
+template <typename T>
+void clearPool(QVector<T> &pool)
+{
+    if (pool.isDetached()) {
+        pool.clear();
+        return;
+    }
+    const int capacity = pool.capacity();
+    pool = QVector<T>();
+    pool.reserve(capacity);
+}
+
+qreal distanceToSegment(const QPointF &p, const QPointF &a, const QPointF &b)
+{
+    const QPointF ab = b - a;
+    const qreal lengthSquared = QPointF::dotProduct(ab, ab);
+    if (qFuzzyIsNull(lengthSquared))
+        return QLineF(p, a).length();
+
+    const qreal t = qBound<qreal>(0.0, QPointF::dotProduct(p - a, ab) / lengthSquared, 1.0);
+    return QLineF(p, a + ab * t).length();
+}
+
+qreal edgeSign(const QPointF &p, const QPointF &a, const QPointF &b)
+{
+    return (p.x() - b.x()) * (a.y() - b.y()) - (a.x() - b.x()) * (p.y() - b.y());
+}
+
+QPointF pointAt(const float *xy, int i)
+{
+    return QPointF(xy[2 * i], xy[2 * i + 1]);
+}
+
+// Even-odd rule, matching QPainter::drawPolygon's default fill.
+bool polygonContains(const float *xy, int count, const QPointF &p)
+{
+    bool inside = false;
+    for (int i = 0, j = count - 1; i < count; j = i++) {
+        const QPointF a = pointAt(xy, i);
+        const QPointF b = pointAt(xy, j);
+        if ((a.y() > p.y()) != (b.y() > p.y())
+            && p.x() < (b.x() - a.x()) * (p.y() - a.y()) / (b.y() - a.y()) + a.x())
+            inside = !inside;
+    }
+    return inside;
+}
+
+qreal distanceToPath(const float *xy, int count, bool closed, const QPointF &p)
+{
+    qreal best = count > 0 ? QLineF(p, pointAt(xy, 0)).length() : 0.0;
+    for (int i = 1; i < count; ++i)
+        best = qMin(best, distanceToSegment(p, pointAt(xy, i - 1), pointAt(xy, i)));
+    if (closed && count > 2)
+        best = qMin(best, distanceToSegment(p, pointAt(xy, count - 1), pointAt(xy, 0)));
+    return best;
+}
+
+// Style plus the raw geometry union. make*() and the Shape constructor zero
+// the whole union, so unused trailing floats compare equal too.
+bool sameRecord(const Shape &a, const Shape &b)
+{
+    return a.type == b.type && a.penWidth == b.penWidth && a.fill == b.fill && a.stroke == b.stroke
+        && std::memcmp(&a.triangle, &b.triangle, sizeof(TriangleGeometry)) == 0;
+}
+
+// Compares the x, y, width, height head every pooled geometry starts with.
+bool sameBox(const float *a, const float *b)
+{
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2] && a[3] == b[3];
+}
+
+} // namespace
+
+QRectF Shape::boundingRect() const
+{
+    QRectF bounds;
+    switch (type) {
+    case ShapeType::FilledCircle:
+    case ShapeType::StrokeCircle: {
+        const qreal r = qAbs(circle.radius);
+        bounds = QRectF(circle.cx - r, circle.cy - r, 2 * r, 2 * r);
+        break;
+    }
+    case ShapeType::Rect:
+        bounds = QRectF(rect.x, rect.y, rect.width, rect.height).normalized();
+        break;
+    case ShapeType::Triangle: {
+        const qreal left = qMin(triangle.x1, qMin(triangle.x2, triangle.x3));
+        const qreal right = qMax(triangle.x1, qMax(triangle.x2, triangle.x3));
+        const qreal top = qMin(triangle.y1, qMin(triangle.y2, triangle.y3));
+        const qreal bottom = qMax(triangle.y1, qMax(triangle.y2, triangle.y3));
+        bounds = QRectF(QPointF(left, top), QPointF(right, bottom));
+        break;
+    }
+    case ShapeType::Line:
+        bounds = QRectF(QPointF(line.x1, line.y1), QPointF(line.x2, line.y2)).normalized();
+        break;
+    case ShapeType::Polyline:
+    case ShapeType::Polygon:
+        bounds = QRectF(path.x, path.y, path.width, path.height);
+        break;
+    case ShapeType::Instances:
+        // Already the union of the painted instance bounds.
+        return QRectF(instances.x, instances.y, instances.width, instances.height);
+    case ShapeType::Text:
+        return QRectF(text.x, text.y, text.width, text.height);
+    case ShapeType::Image:
+        return QRectF(image.x, image.y, image.width, image.height).normalized();
+    }
+
+    if (hasStroke() && type != ShapeType::FilledCircle) {
+        const qreal margin = qAbs(penWidth);
+        bounds.adjust(-margin, -margin, margin, margin);
+    }
+    return bounds;
+}
+
+bool Shape::hitTest(const QPointF &point, qreal tolerance) const
+{
+    const qreal halfPen = hasStroke() ? qAbs(penWidth) / 2 : 0.0;
+    const qreal reach = halfPen + tolerance;
+
+    switch (type) {
+    case ShapeType::FilledCircle:
+        return QLineF(point, QPointF(circle.cx, circle.cy)).length() <= qAbs(circle.radius) + tolerance;
+    case ShapeType::StrokeCircle: {
+        const qreal d = QLineF(point, QPointF(circle.cx, circle.cy)).length();
+        return qAbs(d - qAbs(circle.radius)) <= reach;
+    }
+    case ShapeType::Rect: {
+        const QRectF r = QRectF(rect.x, rect.y, rect.width, rect.height).normalized();
+        if (hasFill() && r.adjusted(-tolerance, -tolerance, tolerance, tolerance).contains(point))
+            return true;
+        if (!hasStroke())
+            return false;
+        const QRectF outer = r.adjusted(-reach, -reach, reach, reach);
+        const QRectF inner = r.adjusted(reach, reach, -reach, -reach);
+        return outer.contains(point) && !(inner.isValid() && inner.contains(point));
+    }
+    case ShapeType::Triangle: {
+        const QPointF a(triangle.x1, triangle.y1);
+        const QPointF b(triangle.x2, triangle.y2);
+        const QPointF c(triangle.x3, triangle.y3);
+        if (hasFill()) {
+            const qreal d1 = edgeSign(point, a, b);
+            const qreal d2 = edgeSign(point, b, c);
+            const qreal d3 = edgeSign(point, c, a);
+            const bool hasNegative = d1 < 0 || d2 < 0 || d3 < 0;
+            const bool hasPositive = d1 > 0 || d2 > 0 || d3 > 0;
+            if (!(hasNegative && hasPositive))
+                return true;
+        }
+        if (!hasStroke() && tolerance <= 0.0)
+            return false;
+        const qreal edge = qMin(distanceToSegment(point, a, b),
+                                qMin(distanceToSegment(point, b, c), distanceToSegment(point, c, a)));
+        return edge <= reach;
+    }
+    case ShapeType::Line:
+        return distanceToSegment(point, QPointF(line.x1, line.y1), QPointF(line.x2, line.y2)) <= reach;
+    case ShapeType::Polyline:
+    case ShapeType::Polygon:
+    case ShapeType::Instances:
+    case ShapeType::Text:
+    case ShapeType::Image:
+        return boundsTouch(boundingRect().adjusted(-tolerance, -tolerance, tolerance, tolerance),
+                           QRectF(point, QSizeF(0, 0)));
+    }
+    return false;
+}
+
+Shape Shape::placed(float scale, float dx, float dy) const
+{
+    Shape s = *this;
+    switch (type) {
+    case ShapeType::FilledCircle:
+    case ShapeType::StrokeCircle:
+        s.circle.cx = circle.cx * scale + dx;
+        s.circle.cy = circle.cy * scale + dy;
+        s.circle.radius = circle.radius * scale;
+        break;
+    case ShapeType::Rect:
+        s.rect.x = rect.x * scale + dx;
+        s.rect.y = rect.y * scale + dy;
+        s.rect.width = rect.width * scale;
+        s.rect.height = rect.height * scale;
+        break;
+    case ShapeType::Triangle:
+        s.triangle.x1 = triangle.x1 * scale + dx;
+        s.triangle.y1 = triangle.y1 * scale + dy;
+        s.triangle.x2 = triangle.x2 * scale + dx;
+        s.triangle.y2 = triangle.y2 * scale + dy;
+        s.triangle.x3 = triangle.x3 * scale + dx;
+        s.triangle.y3 = triangle.y3 * scale + dy;
+        break;
+    case ShapeType::Line:
+        s.line.x1 = line.x1 * scale + dx;
+        s.line.y1 = line.y1 * scale + dy;
+        s.line.x2 = line.x2 * scale + dx;
+        s.line.y2 = line.y2 * scale + dy;
+        break;
+    case ShapeType::Polyline:
+    case ShapeType::Polygon:
+    case ShapeType::Instances:
+    case ShapeType::Text:
+    case ShapeType::Image:
+        break;
+    }
+    return s;
+}
+
+void ShapeList::clear()
+{
+    clearPool(m_shapes);
+    clearPool(m_points);
+    clearPool(m_sets);
+    clearPool(m_instances);
+    clearPool(m_texts);
+    clearPool(m_images);
+}
+
+void ShapeList::append(const ShapeList &other)
+{
+    if (other.m_points.isEmpty() && other.m_sets.isEmpty() && other.m_texts.isEmpty()
+        && other.m_images.isEmpty()) {
+        appendPool(m_shapes, other.m_shapes);
+        return;
+    }
+
+    // Ranges of the appended shapes move behind our own pool contents.
+    const quint32 pointBase = quint32(m_points.size() / 2);
+    const quint32 setBase = quint32(m_sets.size());
+    const quint32 instanceBase = quint32(m_instances.size());
+    const quint32 textBase = quint32(m_texts.size());
+    const quint32 imageBase = quint32(m_images.size());
+    const int first = m_shapes.size();
+    const int firstSet = m_sets.size();
+    appendPool(m_shapes, other.m_shapes);
+    appendPool(m_points, other.m_points);
+    appendPool(m_sets, other.m_sets);
+    appendPool(m_instances, other.m_instances);
+    appendPool(m_texts, other.m_texts);
+    appendPool(m_images, other.m_images);
+
+    for (int i = firstSet; i < m_sets.size(); ++i)
+        m_sets[i].first += instanceBase;
+    Shape *shapes = m_shapes.data();
+    for (int i = first; i < m_shapes.size(); ++i) {
+        if (shapes[i].isPath())
+            shapes[i].path.first += pointBase;
+        else if (shapes[i].type == ShapeType::Instances)
+            shapes[i].instances.set += setBase;
+        else if (shapes[i].type == ShapeType::Text)
+            shapes[i].text.text += textBase;
+        else if (shapes[i].type == ShapeType::Image)
+            shapes[i].image.image += imageBase;
+    }
+}
+
+void ShapeList::append(const ShapeList &other, int first, int count)
+{
+    const int end = qMin(first + count, other.size());
+    for (int i = qMax(0, first); i < end; ++i) {
+        Shape s = other.m_shapes.at(i);
+        switch (s.type) {
+        case ShapeType::Polyline:
+        case ShapeType::Polygon: {
+            const float *xy = other.points(s);
+            s.path.first = quint32(m_points.size() / 2);
+            const int offset = m_points.size();
+            m_points.resize(offset + 2 * int(s.path.count));
+            std::copy(xy, xy + 2 * s.path.count, m_points.data() + offset);
+            break;
+        }
+        case ShapeType::Instances: {
+            InstanceSet set = other.m_sets.at(int(s.instances.set));
+            const Instance *instances = other.instances(s);
+            set.first = quint32(m_instances.size());
+            const int offset = m_instances.size();
+            m_instances.resize(offset + int(s.instances.count));
+            std::copy(instances, instances + s.instances.count, m_instances.data() + offset);
+            s.instances.set = quint32(m_sets.size());
+            m_sets.append(set);
+            break;
+        }
+        case ShapeType::Text:
+            m_texts.append(other.m_texts.at(int(s.text.text)));
+            s.text.text = quint32(m_texts.size() - 1);
+            break;
+        case ShapeType::Image:
+            m_images.append(other.m_images.at(int(s.image.image)));
+            s.image.image = quint32(m_images.size() - 1);
+            break;
+        default:
+            break;
+        }
+        m_shapes.append(s);
+    }
+}
+
+bool ShapeList::sameShape(int i, const ShapeList &other, int j) const
+{
+    const Shape &a = m_shapes.at(i);
+    const Shape &b = other.m_shapes.at(j);
+    if (a.isPrimitive() || b.isPrimitive())
+        return sameRecord(a, b);
+    if (a.type != b.type || a.penWidth != b.penWidth || a.fill != b.fill || a.stroke != b.stroke)
+        return false;
+
+    switch (a.type) {
+    case ShapeType::Polyline:
+    case ShapeType::Polygon:
+        return sameBox(&a.path.x, &b.path.x) && a.path.count == b.path.count
+            && std::equal(points(a), points(a) + 2 * a.path.count, other.points(b));
+    case ShapeType::Instances:
+        return sameBox(&a.instances.x, &b.instances.x) && a.instances.count == b.instances.count
+            && sameRecord(instanceTemplate(a), other.instanceTemplate(b))
+            && std::memcmp(instances(a), other.instances(b), a.instances.count * sizeof(Instance)) == 0;
+    case ShapeType::Text:
+        return sameBox(&a.text.x, &b.text.x) && textPosition(a) == other.textPosition(b)
+            && text(a) == other.text(b) && font(a) == other.font(b);
+    case ShapeType::Image:
+        // Images from the shared cache compare by identity before pixels.
+        return sameBox(&a.image.x, &b.image.x) && image(a) == other.image(b);
+    default:
+        return false;
+    }
+}
+
+void ShapeList::appendPath(ShapeType type, const float *xy, int pointCount,
+                           QRgb fill, QRgb stroke, qreal penWidth)
+{
+    if (pointCount <= 0)
+        return;
+
+    float left = xy[0];
+    float right = xy[0];
+    float top = xy[1];
+    float bottom = xy[1];
+    for (int i = 1; i < pointCount; ++i) {
+        left = qMin(left, xy[2 * i]);
+        right = qMax(right, xy[2 * i]);
+        top = qMin(top, xy[2 * i + 1]);
+        bottom = qMax(bottom, xy[2 * i + 1]);
+    }
+
+    Shape s;
+    s.type = type;
+    s.fill = type == ShapeType::Polygon ? fill : 0;
+    s.stroke = stroke;
+    s.penWidth = float(penWidth);
+    s.path.x = left;
+    s.path.y = top;
+    s.path.width = right - left;
+    s.path.height = bottom - top;
+    s.path.first = quint32(m_points.size() / 2);
+    s.path.count = quint32(pointCount);
+
+    const int offset = m_points.size();
+    m_points.resize(offset + 2 * pointCount);
+    std::copy(xy, xy + 2 * pointCount, m_points.data() + offset);
+    m_shapes.append(s);
+}
+
+void ShapeList::appendInstances(const Shape &templ, const Instance *instances, int count)
+{
+    if (count <= 0 || !templ.isPrimitive())
+        return;
+
+    InstanceSet set;
+    set.templ = templ;
+    set.first = quint32(m_instances.size());
+    m_sets.append(set);
+    const int offset = m_instances.size();
+    m_instances.resize(offset + count);
+    std::copy(instances, instances + count, m_instances.data() + offset);
+
+    // The record carries the template style so run batching and level of
+    // detail treat the set like any other shape.
+    Shape s;
+    s.type = ShapeType::Instances;
+    s.fill = templ.fill;
+    s.stroke = templ.stroke;
+    s.penWidth = templ.penWidth;
+    s.instances.set = quint32(m_sets.size() - 1);
+    s.instances.count = quint32(count);
+
+    qreal left = 0.0;
+    qreal top = 0.0;
+    qreal right = 0.0;
+    qreal bottom = 0.0;
+    for (int i = 0; i < count; ++i) {
+        const QRectF b = instanceShape(s, i).boundingRect();
+        left = i == 0 ? b.left() : qMin(left, b.left());
+        top = i == 0 ? b.top() : qMin(top, b.top());
+        right = i == 0 ? b.right() : qMax(right, b.right());
+        bottom = i == 0 ? b.bottom() : qMax(bottom, b.bottom());
+    }
+    s.instances.x = float(left);
+    s.instances.y = float(top);
+    s.instances.width = float(right - left);
+    s.instances.height = float(bottom - top);
+    m_shapes.append(s);
+}
+
+void ShapeList::appendText(const QPointF &origin, const QString &text, const QFont &font, QRgb color)
+{
+    if (text.isEmpty())
+        return;
+
+    // Measured once here so culling, picking and damage never lay text out.
+    const QFontMetricsF metrics(font);
+    const QRectF layout(origin.x(), origin.y() - metrics.ascent(), metrics.horizontalAdvance(text), metrics.height());
+    const QRectF bounds = layout.united(metrics.boundingRect(text).translated(origin));
+    Shape s;
+    s.type = ShapeType::Text;
+    s.fill = color;
+    s.text.x = float(bounds.x());
+    s.text.y = float(bounds.y());
+    s.text.width = float(bounds.width());
+    s.text.height = float(bounds.height());
+    s.text.text = quint32(m_texts.size());
+
+    TextEntry entry;
+    entry.text = text;
+    entry.font = font;
+    entry.position = layout.topLeft();
+    m_texts.append(entry);
+    m_shapes.append(s);
+}
+
+void ShapeList::appendImage(const QRectF &rect, const QImage &image)
+{
+    if (image.isNull())
+        return;
+
+    Shape s;
+    s.type = ShapeType::Image;
+    s.image.x = float(rect.x());
+    s.image.y = float(rect.y());
+    s.image.width = float(rect.width());
+    s.image.height = float(rect.height());
+    s.image.image = quint32(m_images.size());
+    m_images.append(image);
+    m_shapes.append(s);
+}
+
+void ShapeList::truncate(int size)
+{
+    if (size < 0 || size >= m_shapes.size())
+        return;
+
+    // Pools are filled in append order, so the earliest removed record of
+    // each pooled type marks where its surviving pool data ends. Only the
+    // tail is scanned.
+    int pointsEnd = -1;
+    int setsEnd = -1;
+    int textsEnd = -1;
+    int imagesEnd = -1;
+    for (int i = size; i < m_shapes.size(); ++i) {
+        const Shape &s = m_shapes.at(i);
+        if (s.isPath() && pointsEnd < 0)
+            pointsEnd = int(s.path.first) * 2;
+        else if (s.type == ShapeType::Instances && setsEnd < 0)
+            setsEnd = int(s.instances.set);
+        else if (s.type == ShapeType::Text && textsEnd < 0)
+            textsEnd = int(s.text.text);
+        else if (s.type == ShapeType::Image && imagesEnd < 0)
+            imagesEnd = int(s.image.image);
+    }
+    m_shapes.resize(size);
+    if (pointsEnd >= 0)
+        m_points.resize(pointsEnd);
+    if (setsEnd >= 0) {
+        m_instances.resize(int(m_sets.at(setsEnd).first));
+        m_sets.resize(setsEnd);
+    }
+    if (textsEnd >= 0)
+        m_texts.resize(textsEnd);
+    if (imagesEnd >= 0)
+        m_images.resize(imagesEnd);
+}
+
+Shape ShapeList::instanceShape(const Shape &shape, int i) const
+{
+    const Instance &instance = instances(shape)[i];
+    Shape s = instanceTemplate(shape).placed(instance.scale, instance.x, instance.y);
+    if (instance.flags & Instance::HasColor) {
+        if (s.hasFill())
+            s.fill = instance.color;
+        else
+            s.stroke = instance.color;
+    }
+    return s;
+}
+
+bool ShapeList::hitTest(int index, const QPointF &point, qreal tolerance) const
+{
+    const Shape &s = m_shapes.at(index);
+    if (!s.isPath() && s.type != ShapeType::Instances)
+        return s.hitTest(point, tolerance);
+    if (!s.hitTest(point, tolerance))
+        return false;
+
+    if (s.type == ShapeType::Instances) {
+        for (int i = int(s.instances.count) - 1; i >= 0; --i) {
+            if (instanceShape(s, i).hitTest(point, tolerance))
+                return true;
+        }
+        return false;
+    }
+
+    const float *xy = points(s);
+    const int count = int(s.path.count);
+    const bool closed = s.type == ShapeType::Polygon;
+    if (closed && s.hasFill() && count > 2 && polygonContains(xy, count, point))
+        return true;
+    if (!s.hasStroke() && tolerance <= 0.0)
+        return false;
+
+    const qreal reach = (s.hasStroke() ? qAbs(s.penWidth) / 2 : 0.0) + tolerance;
+    return distanceToPath(xy, count, closed, point) <= reach;
+}
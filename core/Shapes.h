@@ -2,34 +2,320 @@
 #define SHAPES_H
 
 #include <QColor>
+#include <QFont>
+#include <QImage>
 #include <QPointF>
+#include <QRectF>
+#include <QRgb>
 #include <QVector>
 
-enum class ShapeType {
+#include <type_traits>
+
+enum class ShapeType : quint8 {
     FilledCircle,
     StrokeCircle,
     Triangle,
     Rect,
-    Line
+    Line,
+    // Types from here on keep data in a ShapeList pool; see isPrimitive().
+    Polyline,
+    Polygon,
+    Instances,
+    Text,
+    Image
+};
+
+// Colors are stored as premultiplied 32-bit ARGB so renderers can blend them
+// directly. A fully transparent value means "not painted".
+inline QRgb packColor(const QColor &color)
+{
+    return color.isValid() ? qPremultiply(color.rgba()) : 0;
+}
+
+inline QColor unpackColor(QRgb color)
+{
+    return QColor::fromRgba(qUnpremultiply(color));
+}
+
+// Per-type geometry. Coordinates are floats: canvas units never need more
+// precision and it halves the footprint compared to QPointF.
+struct LineGeometry
+{
+    float x1, y1, x2, y2;
+};
+
+struct RectGeometry
+{
+    float x, y, width, height;
+};
+
+struct CircleGeometry
+{
+    float cx, cy, radius;
+};
+
+struct TriangleGeometry
+{
+    float x1, y1, x2, y2, x3, y3;
+};
+
+// Polylines and polygons keep their points in the owning ShapeList's pool;
+// the record holds the point range plus the cached bounds of the points.
+struct PathGeometry
+{
+    float   x, y, width, height;
+    quint32 first;
+    quint32 count;
+};
+
+// An instance set stamps one template shape at many positions. The record
+// holds the bounds of all instances and the index of the set in the owning
+// ShapeList, which stores the template and the per-instance data.
+struct InstanceGeometry
+{
+    float   x, y, width, height;
+    quint32 set;
+    quint32 count;
+};
+
+// Text labels keep their string, font and layout position in the owning
+// ShapeList's pool; the record holds the painted bounds measured when
+// appended: the layout box united with the glyphs' ink, which overhangs it
+// for italics and negative bearings.
+struct TextGeometry
+{
+    float   x, y, width, height;
+    quint32 text;
 };
 
+// Images reference a decoded QImage in the owning ShapeList's pool and are
+// scaled into the target rect.
+struct ImageGeometry
+{
+    float   x, y, width, height;
+    quint32 image;
+};
+
+// Per-instance data: position, uniform scale of the template geometry (pen
+// widths are not scaled) and, with HasColor set, a premultiplied color that
+// replaces the template's fill, or its stroke when it has no fill. Without
+// the flag the template's colors are kept; a transparent color hides the
+// instance. No padding, so sets compare bytewise.
+struct Instance
+{
+    enum Flag : quint32 {
+        HasColor = 0x1
+    };
+
+    float   x, y, scale;
+    QRgb    color;
+    quint32 flags;
+};
+
+Q_DECLARE_TYPEINFO(Instance, Q_PRIMITIVE_TYPE);
+
+// Compact, trivially copyable record (40 bytes) so paint and undo loops stay
+// cache friendly even with millions of shapes. Use the make*() helpers rather
+// than filling the union by hand.
 struct Shape
 {
     ShapeType type;
-    QPointF   p1;
-    QPointF   p2;
-    QPointF   p3;
-    QPointF   p4;
-    QColor    fillColor;
-    QColor    strokeColor;
-    qreal     penWidth;
+    float     penWidth;
+    QRgb      fill;
+    QRgb      stroke;
+    union {
+        LineGeometry     line;
+        RectGeometry     rect;
+        CircleGeometry   circle;
+        TriangleGeometry triangle;
+        PathGeometry     path;
+        InstanceGeometry instances;
+        TextGeometry     text;
+        ImageGeometry    image;
+    };
 
     Shape()
         : type(ShapeType::FilledCircle)
-        , penWidth(1.0)
+        , penWidth(1.0f)
+        , fill(0)
+        , stroke(0)
+        , triangle()
     {}
+
+    bool hasFill() const { return qAlpha(fill) != 0; }
+    bool hasStroke() const { return qAlpha(stroke) != 0; }
+    QColor fillColor() const { return unpackColor(fill); }
+    QColor strokeColor() const { return unpackColor(stroke); }
+    bool isPath() const { return type == ShapeType::Polyline || type == ShapeType::Polygon; }
+    // Whole shape in the record, without data in a ShapeList pool.
+    bool isPrimitive() const { return type <= ShapeType::Line; }
+
+    // Area the shape can touch once painted. The stroke margin is a full pen
+    // width so miter joins and square caps are always covered.
+    QRectF boundingRect() const;
+    // Precise test used for picking; tolerance widens strokes and edges.
+    // Pooled shapes (paths, instance sets, text, images) only test their
+    // bounds here;
+    // ShapeList::hitTest() sees the points and instances.
+    bool hitTest(const QPointF &point, qreal tolerance = 0.0) const;
+    // Geometry scaled about the origin, then moved by (dx, dy); the pen width
+    // is left alone. Pooled shapes are returned unchanged.
+    Shape placed(float scale, float dx, float dy) const;
+
+    static Shape makeLine(const QPointF &p1, const QPointF &p2, QRgb stroke, qreal penWidth)
+    {
+        Shape s;
+        s.type = ShapeType::Line;
+        s.stroke = stroke;
+        s.penWidth = float(penWidth);
+        s.line.x1 = float(p1.x());
+        s.line.y1 = float(p1.y());
+        s.line.x2 = float(p2.x());
+        s.line.y2 = float(p2.y());
+        return s;
+    }
+
+    static Shape makeRect(const QRectF &r, QRgb fill, QRgb stroke, qreal penWidth)
+    {
+        Shape s;
+        s.type = ShapeType::Rect;
+        s.fill = fill;
+        s.stroke = stroke;
+        s.penWidth = float(penWidth);
+        s.rect.x = float(r.x());
+        s.rect.y = float(r.y());
+        s.rect.width = float(r.width());
+        s.rect.height = float(r.height());
+        return s;
+    }
+
+    static Shape makeFilledCircle(const QPointF &center, qreal radius, QRgb fill)
+    {
+        Shape s;
+        s.type = ShapeType::FilledCircle;
+        s.fill = fill;
+        s.circle.cx = float(center.x());
+        s.circle.cy = float(center.y());
+        s.circle.radius = float(radius);
+        return s;
+    }
+
+    static Shape makeStrokeCircle(const QPointF &center, qreal radius, QRgb stroke, qreal penWidth)
+    {
+        Shape s = makeFilledCircle(center, radius, 0);
+        s.type = ShapeType::StrokeCircle;
+        s.stroke = stroke;
+        s.penWidth = float(penWidth);
+        return s;
+    }
+
+    static Shape makeTriangle(const QPointF &p1, const QPointF &p2, const QPointF &p3,
+                              QRgb fill, QRgb stroke, qreal penWidth)
+    {
+        Shape s;
+        s.type = ShapeType::Triangle;
+        s.fill = fill;
+        s.stroke = stroke;
+        s.penWidth = float(penWidth);
+        s.triangle.x1 = float(p1.x());
+        s.triangle.y1 = float(p1.y());
+        s.triangle.x2 = float(p2.x());
+        s.triangle.y2 = float(p2.y());
+        s.triangle.x3 = float(p3.x());
+        s.triangle.y3 = float(p3.y());
+        return s;
+    }
 };
 
-typedef QVector<Shape> ShapeList;
+static_assert(std::is_trivially_copyable<Shape>::value,
+              "Shape must stay a plain record; keep owning types out of it");
+
+Q_DECLARE_TYPEINFO(Shape, Q_PRIMITIVE_TYPE);
+
+// Shapes in paint order plus the pools that hold path points (interleaved
+// x, y floats), instance sets, text labels and images. Implicitly shared like the
+// QVector<Shape> it replaces; appending and truncating keep pool ranges
+// consistent.
+class ShapeList
+{
+public:
+    typedef QVector<Shape>::const_iterator const_iterator;
+
+    int size() const { return m_shapes.size(); }
+    bool isEmpty() const { return m_shapes.isEmpty(); }
+    const Shape &at(int i) const { return m_shapes.at(i); }
+    const Shape &last() const { return m_shapes.last(); }
+    const_iterator begin() const { return m_shapes.constBegin(); }
+    const_iterator end() const { return m_shapes.constEnd(); }
+
+    void reserve(int size) { m_shapes.reserve(size); }
+    // Keeps the capacity of every pool for the next fill; a pool shared with
+    // a copy gets a fresh buffer of the same capacity instead.
+    void clear();
+    // For single-record shapes; paths go through appendPath().
+    void append(const Shape &shape) { m_shapes.append(shape); }
+    void append(const ShapeList &other);
+    // Appends count shapes of other starting at first, with their pool data.
+    void append(const ShapeList &other, int first, int count);
+    ShapeList &operator+=(const ShapeList &other) { append(other); return *this; }
+    // Appends a Polyline or Polygon; xy holds pointCount x, y pairs.
+    void appendPath(ShapeType type, const float *xy, int pointCount,
+                    QRgb fill, QRgb stroke, qreal penWidth);
+    // Appends one Instances record stamping templ (geometry relative to the
+    // instance position; circles, rects, triangles and lines) count times.
+    void appendInstances(const Shape &templ, const Instance *instances, int count);
+    // Appends a Text label whose baseline starts at origin.
+    void appendText(const QPointF &origin, const QString &text, const QFont &font, QRgb color);
+    // Appends an Image drawn scaled into rect. The image is shared, not copied.
+    void appendImage(const QRectF &rect, const QImage &image);
+    void removeLast() { truncate(m_shapes.size() - 1); }
+    void truncate(int size);
+
+    const float *points(const Shape &shape) const { return m_points.constData() + 2 * shape.path.first; }
+    const Shape &instanceTemplate(const Shape &shape) const { return m_sets.at(int(shape.instances.set)).templ; }
+    const Instance *instances(const Shape &shape) const
+    {
+        return m_instances.constData() + m_sets.at(int(shape.instances.set)).first;
+    }
+    const QString &text(const Shape &shape) const { return m_texts.at(int(shape.text.text)).text; }
+    const QFont &font(const Shape &shape) const { return m_texts.at(int(shape.text.text)).font; }
+    // Top-left of the label's layout box, where it is drawn from.
+    QPointF textPosition(const Shape &shape) const { return m_texts.at(int(shape.text.text)).position; }
+    const QImage &image(const Shape &shape) const { return m_images.at(int(shape.image.image)); }
+    // The concrete shape instance i of an Instances record stands for.
+    Shape instanceShape(const Shape &shape, int i) const;
+    // True when shape i paints exactly like shape j of other, comparing pool
+    // contents rather than pool positions.
+    bool sameShape(int i, const ShapeList &other, int j) const;
+    // Shape::hitTest() plus exact tests for paths and instance sets.
+    bool hitTest(int index, const QPointF &point, qreal tolerance = 0.0) const;
+
+private:
+    struct InstanceSet
+    {
+        Shape   templ;
+        quint32 first;
+    };
+    struct TextEntry
+    {
+        QString text;
+        QFont   font;
+        QPointF position;
+    };
+
+    QVector<Shape>       m_shapes;
+    QVector<float>       m_points;
+    QVector<InstanceSet> m_sets;
+    QVector<Instance>    m_instances;
+    QVector<TextEntry>   m_texts;
+    QVector<QImage>      m_images;
+};
+
+// Unlike QRectF::intersects this keeps zero-area bounds such as hairlines.
+inline bool boundsTouch(const QRectF &a, const QRectF &b)
+{
+    return a.left() <= b.right() && b.left() <= a.right()
+        && a.top() <= b.bottom() && b.top() <= a.bottom();
+}
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,144 @@
+#include "SpatialIndex.h"
+
+#include <QtMath>
+#include <qnumeric.h>
+
+#include <algorithm>
+
+namespace {
+
+// Beyond this a shape is cheaper to test directly than to register per cell.
+const qint64 kMaxCellsPerShape = 256;
+// Keeps cell coordinates well inside int even for absurd script input.
+const qreal kMaxCoordinate = 1.0e7;
+
+void removeFromBack(QVector<int> &indices, int index)
+{
+    for (int i = indices.size() - 1; i >= 0; --i) {
+        if (indices.at(i) == index) {
+            indices.remove(i);
+            return;
+        }
+    }
+}
+
+} // namespace
+
+SpatialIndex::SpatialIndex(qreal cellSize)
+    : m_cellSize(cellSize > 0.0 ? cellSize : 64.0)
+{
+}
+
+void SpatialIndex::clear()
+{
+    m_cells.clear();
+    m_overflow.clear();
+}
+
+void SpatialIndex::rebuild(const ShapeList &shapes)
+{
+    clear();
+    for (int i = 0; i < shapes.size(); ++i)
+        insert(i, shapes.at(i).boundingRect());
+}
+
+void SpatialIndex::insert(int index, const QRectF &bounds)
+{
+    CellRange range;
+    if (isOverflow(bounds, &range)) {
+        m_overflow.append(index);
+        return;
+    }
+
+    for (int y = range.top; y <= range.bottom; ++y) {
+        for (int x = range.left; x <= range.right; ++x)
+            m_cells[cellKey(x, y)].append(index);
+    }
+}
+
+void SpatialIndex::remove(int index, const QRectF &bounds)
+{
+    CellRange range;
+    if (isOverflow(bounds, &range)) {
+        removeFromBack(m_overflow, index);
+        return;
+    }
+
+    for (int y = range.top; y <= range.bottom; ++y) {
+        for (int x = range.left; x <= range.right; ++x) {
+            auto it = m_cells.find(cellKey(x, y));
+            if (it == m_cells.end())
+                continue;
+            removeFromBack(it.value(), index);
+            if (it.value().isEmpty())
+                m_cells.erase(it);
+        }
+    }
+}
+
+QVector<int> SpatialIndex::candidates(const QRectF &rect) const
+{
+    QVector<int> result = m_overflow;
+
+    CellRange range;
+    if (!cellRange(rect, &range)) {
+        for (auto it = m_cells.constBegin(); it != m_cells.constEnd(); ++it)
+            result += it.value();
+    } else {
+        // Zoomed-out views can span more cells than are populated; walk
+        // whichever side is smaller.
+        if (cellCount(range) > m_cells.size()) {
+            for (auto it = m_cells.constBegin(); it != m_cells.constEnd(); ++it) {
+                const int x = qint32(it.key() >> 32);
+                const int y = qint32(it.key() & 0xffffffffu);
+                if (x >= range.left && x <= range.right && y >= range.top && y <= range.bottom)
+                    result += it.value();
+            }
+        } else {
+            for (int y = range.top; y <= range.bottom; ++y) {
+                for (int x = range.left; x <= range.right; ++x) {
+                    auto it = m_cells.constFind(cellKey(x, y));
+                    if (it != m_cells.constEnd())
+                        result += it.value();
+                }
+            }
+        }
+    }
+
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+bool SpatialIndex::cellRange(const QRectF &bounds, CellRange *range) const
+{
+    if (!qIsFinite(bounds.left()) || !qIsFinite(bounds.top())
+        || !qIsFinite(bounds.right()) || !qIsFinite(bounds.bottom()))
+        return false;
+
+    const qreal left = qBound(-kMaxCoordinate, bounds.left(), kMaxCoordinate);
+    const qreal top = qBound(-kMaxCoordinate, bounds.top(), kMaxCoordinate);
+    const qreal right = qBound(-kMaxCoordinate, bounds.right(), kMaxCoordinate);
+    const qreal bottom = qBound(-kMaxCoordinate, bounds.bottom(), kMaxCoordinate);
+
+    range->left = qFloor(left / m_cellSize);
+    range->top = qFloor(top / m_cellSize);
+    range->right = qFloor(right / m_cellSize);
+    range->bottom = qFloor(bottom / m_cellSize);
+    return true;
+}
+
+bool SpatialIndex::isOverflow(const QRectF &bounds, CellRange *range) const
+{
+    return !cellRange(bounds, range) || cellCount(*range) > kMaxCellsPerShape;
+}
+
+qint64 SpatialIndex::cellCount(const CellRange &range)
+{
+    return qint64(range.right - range.left + 1) * (range.bottom - range.top + 1);
+}
+
+quint64 SpatialIndex::cellKey(int x, int y)
+{
+    return (quint64(quint32(x)) << 32) | quint32(y);
+}
@@ -0,0 +1,48 @@
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <QHash>
+#include <QRectF>
+#include <QVector>
+
+#include "Shapes.h"
+
+// Uniform grid over canvas coordinates that maps cells to shape indices.
+// Updates are incremental so appending a shape costs only the cells it
+// touches; shapes spanning too many cells (or with non-finite bounds) sit in
+// an overflow list that every query returns.
+class SpatialIndex
+{
+public:
+    explicit SpatialIndex(qreal cellSize = 64.0);
+
+    void clear();
+    void rebuild(const ShapeList &shapes);
+    void insert(int index, const QRectF &bounds);
+    // Cheapest for the most recently inserted indices, which is what undo needs.
+    void remove(int index, const QRectF &bounds);
+
+    // Candidate indices whose cells intersect rect, sorted ascending so the
+    // caller can paint them in z-order. Callers filter on exact bounds.
+    QVector<int> candidates(const QRectF &rect) const;
+
+private:
+    struct CellRange
+    {
+        int left;
+        int top;
+        int right;
+        int bottom;
+    };
+
+    bool cellRange(const QRectF &bounds, CellRange *range) const;
+    bool isOverflow(const QRectF &bounds, CellRange *range) const;
+    static qint64 cellCount(const CellRange &range);
+    static quint64 cellKey(int x, int y);
+
+    qreal                         m_cellSize;
+    QHash<quint64, QVector<int> > m_cells;
+    QVector<int>                  m_overflow;
+};
+
+#endif
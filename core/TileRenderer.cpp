@@ -0,0 +1,207 @@
+#include "TileRenderer.h"
+
+#include "SceneRenderer.h"
+
+#include <QAtomicInt>
+#include <QPainter>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QtMath>
+
+namespace {
+
+struct Tile
+{
+    QRect        rect;
+    QVector<int> indices;
+};
+
+// Everything the workers share. Tiles are claimed through an atomic cursor so
+// fast threads pick up the slack of slow ones.
+struct TileJob
+{
+    uchar           *bits;
+    int              bytesPerLine;
+    int              bytesPerPixel;
+    QImage::Format   format;
+    qreal            scale;
+    const ShapeList *shapes;
+    LevelOfDetail    lod;
+    QVector<Tile>    tiles;
+    QAtomicInt       nextTile;
+};
+
+void renderTiles(TileJob &job)
+{
+    SceneRenderer renderer;
+    renderer.setLevelOfDetail(job.lod);
+    for (;;) {
+        const int t = job.nextTile.fetchAndAddRelaxed(1);
+        if (t >= job.tiles.size())
+            return;
+
+        const Tile &tile = job.tiles.at(t);
+        // The tile image aliases the target's memory: nothing to composite
+        // afterwards, and each thread owns a distinct paint device.
+        uchar *origin = job.bits + tile.rect.y() * job.bytesPerLine + tile.rect.x() * job.bytesPerPixel;
+        QImage view(origin, tile.rect.width(), tile.rect.height(), job.bytesPerLine, job.format);
+
+        QPainter p(&view);
+        p.setRenderHint(QPainter::Antialiasing, true);
+        p.translate(-tile.rect.x(), -tile.rect.y());
+        p.scale(job.scale, job.scale);
+        renderer.draw(p, *job.shapes, tile.indices);
+    }
+}
+
+class TileWorker : public QRunnable
+{
+public:
+    TileWorker(TileJob *job, QSemaphore *finished)
+        : m_job(job)
+        , m_finished(finished)
+    {
+    }
+
+    void run() override
+    {
+        renderTiles(*m_job);
+        m_finished->release();
+    }
+
+private:
+    TileJob    *m_job;
+    QSemaphore *m_finished;
+};
+
+} // namespace
+
+TileRenderer::TileRenderer(QThreadPool *pool)
+    : m_pool(pool ? pool : QThreadPool::globalInstance())
+    , m_tileSize(256)
+    , m_parallelThreshold(2000)
+{
+}
+
+void TileRenderer::setTileSize(int pixels)
+{
+    m_tileSize = qMax(16, pixels);
+}
+
+void TileRenderer::setParallelThreshold(int shapeCount)
+{
+    m_parallelThreshold = qMax(0, shapeCount);
+}
+
+void TileRenderer::setLevelOfDetail(const LevelOfDetail &lod)
+{
+    m_lod = lod;
+}
+
+LevelOfDetail TileRenderer::levelOfDetail() const
+{
+    return m_lod;
+}
+
+void TileRenderer::render(QImage &target, const ShapeList &shapes, const QVector<int> &indices, qreal zoom) const
+{
+    if (indices.isEmpty() || target.isNull())
+        return;
+
+    const int columns = (target.width() + m_tileSize - 1) / m_tileSize;
+    const int rows = (target.height() + m_tileSize - 1) / m_tileSize;
+    const int helpers = qMin(m_pool->maxThreadCount(), columns * rows - 1);
+    if (indices.size() < m_parallelThreshold || helpers <= 0 || target.depth() % 8 != 0) {
+        renderSerial(target, shapes, indices, zoom);
+        return;
+    }
+
+    TileJob job;
+    job.bits = target.bits();
+    job.bytesPerLine = target.bytesPerLine();
+    job.bytesPerPixel = target.depth() / 8;
+    job.format = target.format();
+    job.scale = zoom * target.devicePixelRatio();
+    job.shapes = &shapes;
+    job.lod = m_lod;
+    job.tiles.resize(columns * rows);
+    for (int row = 0; row < rows; ++row) {
+        for (int column = 0; column < columns; ++column) {
+            const QRect r(column * m_tileSize, row * m_tileSize, m_tileSize, m_tileSize);
+            job.tiles[row * columns + column].rect = r.intersected(target.rect());
+        }
+    }
+
+    // Bin in paint order so every tile list is already z-sorted. One device
+    // pixel of slack covers antialiasing outside the geometric bounds.
+    for (int index : indices) {
+        const QRectF b = shapes.at(index).boundingRect();
+        const qreal left = b.left() * job.scale - 1;
+        const qreal top = b.top() * job.scale - 1;
+        const qreal right = b.right() * job.scale + 1;
+        const qreal bottom = b.bottom() * job.scale + 1;
+        if (right < 0 || bottom < 0 || left >= target.width() || top >= target.height())
+            continue;
+
+        const int c0 = qBound(0, int(qFloor(left / m_tileSize)), columns - 1);
+        const int c1 = qBound(0, int(qFloor(right / m_tileSize)), columns - 1);
+        const int r0 = qBound(0, int(qFloor(top / m_tileSize)), rows - 1);
+        const int r1 = qBound(0, int(qFloor(bottom / m_tileSize)), rows - 1);
+        for (int row = r0; row <= r1; ++row) {
+            for (int column = c0; column <= c1; ++column)
+                job.tiles[row * columns + column].indices.append(index);
+        }
+    }
+
+    job.nextTile.storeRelaxed(0);
+    QSemaphore finished;
+    int started = 0;
+    for (int i = 0; i < helpers; ++i) {
+        // Never queue behind other pool work; the calling thread renders too.
+        TileWorker *worker = new TileWorker(&job, &finished);
+        if (!m_pool->tryStart(worker)) {
+            delete worker;
+            break;
+        }
+        ++started;
+    }
+
+    renderTiles(job);
+    finished.acquire(started);
+}
+
+void TileRenderer::renderRect(QImage &target, const QRect &rect, const ShapeList &shapes,
+                              const QVector<int> &indices, qreal zoom) const
+{
+    const QRect area = rect.intersected(target.rect());
+    if (indices.isEmpty() || area.isEmpty() || target.depth() % 8 != 0)
+        return;
+
+    // One tile covering the area: it aliases the target like any other tile,
+    // so nothing outside is painted and no clipping is involved.
+    TileJob job;
+    job.bits = target.bits();
+    job.bytesPerLine = target.bytesPerLine();
+    job.bytesPerPixel = target.depth() / 8;
+    job.format = target.format();
+    job.scale = zoom * target.devicePixelRatio();
+    job.shapes = &shapes;
+    job.lod = m_lod;
+    job.tiles.resize(1);
+    job.tiles[0].rect = area;
+    job.tiles[0].indices = indices;
+    job.nextTile.storeRelaxed(0);
+    renderTiles(job);
+}
+
+void TileRenderer::renderSerial(QImage &target, const ShapeList &shapes, const QVector<int> &indices, qreal zoom) const
+{
+    QPainter p(&target);
+    p.setRenderHint(QPainter::Antialiasing, true);
+    if (!qFuzzyCompare(zoom, 1.0))
+        p.scale(zoom, zoom);
+    SceneRenderer renderer;
+    renderer.setLevelOfDetail(m_lod);
+    renderer.draw(p, shapes, indices);
+}
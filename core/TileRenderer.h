@@ -0,0 +1,44 @@
+#ifndef TILERENDERER_H
+#define TILERENDERER_H
+
+#include <QImage>
+#include <QVector>
+
+#include "SceneRenderer.h"
+#include "Shapes.h"
+
+class QThreadPool;
+
+// Rasterizes shapes into a QImage by splitting it into tiles that render in
+// parallel on a QThreadPool. Shapes are binned to tiles by bounding box and
+// each tile paints its shapes in scene order through an integer-translated
+// painter, so the pixels match a single QPainter pass over the whole image.
+class TileRenderer
+{
+public:
+    explicit TileRenderer(QThreadPool *pool = nullptr);
+
+    void setTileSize(int pixels);
+    // Below this many shapes the threading overhead is not worth it.
+    void setParallelThreshold(int shapeCount);
+    void setLevelOfDetail(const LevelOfDetail &lod);
+    LevelOfDetail levelOfDetail() const;
+
+    // Draws indices (in paint order) over the current content of target,
+    // scaling scene coordinates by zoom and target's device pixel ratio.
+    void render(QImage &target, const ShapeList &shapes, const QVector<int> &indices, qreal zoom) const;
+    // Same, but only touches the pixels in rect (device pixels) on the
+    // calling thread, with the same pixels a full pass would give there.
+    void renderRect(QImage &target, const QRect &rect, const ShapeList &shapes,
+                    const QVector<int> &indices, qreal zoom) const;
+
+private:
+    void renderSerial(QImage &target, const ShapeList &shapes, const QVector<int> &indices, qreal zoom) const;
+
+    QThreadPool  *m_pool;
+    int           m_tileSize;
+    int           m_parallelThreshold;
+    LevelOfDetail m_lod;
+};
+
+#endif
@@ -1,4 +1,6 @@
 QT += core gui widgets
+# qsimd_p.h, for the run-time CPU check in FillRasterizer.
+QT += core-private
 
 CONFIG += c++11 staticlib
 TEMPLATE = lib
@@ -9,11 +11,48 @@ INCLUDEPATH += $$PWD
 SOURCES += \
     ScriptCanvas.cpp \
     ScriptDocument.cpp \
-    CanvasState.cpp
+    CanvasState.cpp \
+    Shapes.cpp \
+    SpatialIndex.cpp \
+    SceneRenderer.cpp \
+    TileRenderer.cpp \
+    FillRasterizer.cpp \
+    CanvasRenderer.cpp \
+    ColorTable.cpp \
+    ImageCache.cpp
 
 HEADERS += \
     ScriptCanvas.h \
     Shapes.h \
     ScriptDocument.h \
-    CanvasState.h
+    CanvasState.h \
+    SpatialIndex.h \
+    SceneRenderer.h \
+    TileRenderer.h \
+    FillRasterizer.h \
+    CanvasRenderer.h \
+    ColorTable.h \
+    ImageCache.h
+
+# FillRasterizer's AVX2 kernel is compiled with AVX2 enabled on its own, the
+# way Qt's simd.prf does it; FillRasterizer only calls into it after
+# qCpuHasFeature(AVX2), so the library still runs on any x86-64 CPU.
+contains(QT_ARCH, x86_64)|contains(QT_ARCH, i386) {
+    isEmpty(QMAKE_CFLAGS_AVX2) {
+        msvc: QMAKE_CFLAGS_AVX2 = -arch:AVX2
+        else: QMAKE_CFLAGS_AVX2 = -mavx2
+    }
+    DEFINES += FILLRASTERIZER_AVX2
+    AVX2_SOURCES += FillRasterizer_avx2.cpp
+
+    avx2_compiler.commands = $$QMAKE_CXX -c $(CXXFLAGS) $$QMAKE_CFLAGS_AVX2 $(INCPATH) ${QMAKE_FILE_IN}
+    msvc: avx2_compiler.commands += -Fo${QMAKE_FILE_OUT}
+    else: avx2_compiler.commands += -o ${QMAKE_FILE_OUT}
+    avx2_compiler.dependency_type = TYPE_C
+    avx2_compiler.output = ${QMAKE_VAR_OBJECTS_DIR}${QMAKE_FILE_BASE}$${first(QMAKE_EXT_OBJ)}
+    avx2_compiler.input = AVX2_SOURCES
+    avx2_compiler.variable_out = OBJECTS
+    avx2_compiler.name = compiling[avx2] ${QMAKE_FILE_IN}
+    QMAKE_EXTRA_COMPILERS += avx2_compiler
+}
 
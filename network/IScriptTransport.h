@@ -25,10 +25,13 @@ public:
     virtual void bind(quint16 localPort) = 0;
     virtual void sendScript(const QByteArray &script, const TransportEndpoint &target) = 0;
     virtual void requestScript(const TransportEndpoint &target) = 0;
+    // Delivers an encoded image (PNG, JPEG, ...) the runner caches under key.
+    virtual void sendImage(const QString &key, const QByteArray &encoded, const TransportEndpoint &target) = 0;
 
 signals:
     void scriptReceived(const QByteArray &script, const TransportEndpoint &sender);
     void scriptRequested(const TransportEndpoint &sender);
+    void imageReceived(const QString &key, const QByteArray &encoded, const TransportEndpoint &sender);
     void statusMessage(const QString &message);
 };
 
@@ -80,6 +80,7 @@ void ProfileManager::loadProfiles()
         profile.editorPort = static_cast<quint16>(obj.value(QStringLiteral("editorPort")).toInt(45454));
         profile.runnerHost = obj.value(QStringLiteral("runnerHost")).toString(QStringLiteral("127.0.0.1"));
         profile.runnerPort = static_cast<quint16>(obj.value(QStringLiteral("runnerPort")).toInt(45455));
+        profile.scriptEngine = obj.value(QStringLiteral("scriptEngine")).toString();
 
         if (profile.isValid())
             m_profiles.append(profile);
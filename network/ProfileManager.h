@@ -13,6 +13,8 @@ struct NetworkProfile
     quint16 editorPort = 0;
     QString runnerHost;
     quint16 runnerPort = 0;
+    // "qtscript" (default) or "qjsengine"; a script header can override it.
+    QString scriptEngine;
 
     bool isValid() const
     {
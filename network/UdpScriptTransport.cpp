@@ -4,6 +4,13 @@
 
 Q_LOGGING_CATEGORY(lcNetworkTransport, "script.network.transport")
 
+namespace {
+
+// "PUT_IMAGE <key>\n" followed by the encoded bytes, all in one datagram.
+const QByteArray imageHeader("PUT_IMAGE ");
+
+} // namespace
+
 UdpScriptTransport::UdpScriptTransport(QObject *parent)
     : IScriptTransport(parent)
     , m_socket(new QUdpSocket(this))
@@ -73,12 +80,59 @@ void UdpScriptTransport::requestScript(const TransportEndpoint &target)
     }
 }
 
+void UdpScriptTransport::sendImage(const QString &key, const QByteArray &encoded, const TransportEndpoint &target)
+{
+    if (target.address.isNull() || target.port == 0) {
+        emit statusMessage(tr("Invalid target endpoint"));
+        qCWarning(lcNetworkTransport) << "Invalid target endpoint";
+        return;
+    }
+
+    const QByteArray keyBytes = key.toUtf8();
+    if (key.isEmpty() || keyBytes.contains('\n')) {
+        emit statusMessage(tr("Invalid image key: %1").arg(key));
+        return;
+    }
+
+    // Everything must fit one datagram; icons do, anything larger belongs on disk.
+    QByteArray payload = imageHeader + keyBytes + '\n';
+    payload += encoded;
+    const qint64 sent = m_socket->writeDatagram(payload, target.address, target.port);
+    if (sent == -1) {
+        const QString error = m_socket->errorString();
+        qCWarning(lcNetworkTransport) << "Failed to send image:" << error;
+        emit statusMessage(tr("Failed to send image %1: %2").arg(key, error));
+    } else {
+        emit statusMessage(tr("Image %1 sent to %2:%3 (%4 bytes)")
+                           .arg(key)
+                           .arg(target.address.toString())
+                           .arg(target.port)
+                           .arg(sent));
+        qCInfo(lcNetworkTransport) << "Image" << key << "sent to" << target.address << target.port << "bytes" << sent;
+    }
+}
+
 void UdpScriptTransport::onReadyRead()
 {
     while (m_socket->hasPendingDatagrams()) {
         QNetworkDatagram datagram = m_socket->receiveDatagram();
         TransportEndpoint endpoint { datagram.senderAddress(), static_cast<quint16>(datagram.senderPort()) };
-        const QByteArray data = datagram.data().trimmed();
+
+        // Image payloads are binary, so they are split off before trimming.
+        const QByteArray raw = datagram.data();
+        if (raw.startsWith(imageHeader)) {
+            const int newline = raw.indexOf('\n', imageHeader.size());
+            if (newline < 0) {
+                qCWarning(lcNetworkTransport) << "Malformed image datagram from" << endpoint.address << endpoint.port;
+                continue;
+            }
+            const QString key = QString::fromUtf8(raw.mid(imageHeader.size(), newline - imageHeader.size()));
+            qCInfo(lcNetworkTransport) << "Image" << key << "received from" << endpoint.address << endpoint.port << "bytes" << raw.size();
+            emit imageReceived(key, raw.mid(newline + 1), endpoint);
+            continue;
+        }
+
+        const QByteArray data = raw.trimmed();
 
         if (data.isEmpty()) {
             // Some OSes deliver zero-byte datagrams when the sender closed the socket.
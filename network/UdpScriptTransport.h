@@ -16,6 +16,7 @@ public:
     void bind(quint16 localPort) override;
     void sendScript(const QByteArray &script, const TransportEndpoint &target) override;
     void requestScript(const TransportEndpoint &target) override;
+    void sendImage(const QString &key, const QByteArray &encoded, const TransportEndpoint &target) override;
 
 private slots:
     void onReadyRead();